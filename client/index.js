@@ -28,6 +28,9 @@ let trailingWhiteSpaces = 0;
 // Holds current simulation time
 let simTime = new Date(0);
 
+// Number of simulated seconds per wall-clock second (obtained from the server)
+let clockSpeed = 1;
+
 // Flag to signify whether text is being edited
 let fileOpen = false;
 
@@ -50,6 +53,31 @@ let slurmSecondsInput;
 // Handler for the clock update activity timer  (setInterval stuff)
 let updateClockTimer;
 
+// Incremented to stop the current server polling loop (see pollServer)
+let pollGeneration = 0;
+
+// How long (in milliseconds) each query may wait on the server for events
+const queryWait = 10000;
+
+// Stream of events pushed by the server, if the browser supports it (otherwise the server is polled)
+let eventSource = null;
+
+// Number of consecutive errors on the event stream (the browser reconnects on its own a few times)
+let eventSourceErrors = 0;
+const maxEventSourceErrors = 3;
+
+// How many times a request the server turned away because it was busy (503) is sent again
+const maxShedRetries = 5;
+
+// Sequence number of the latest event handled, so that the server only sends newer events and
+// that events received both from the stream/polling and from an addTime are handled once
+let eventCursor = 0;
+
+// Local copy of the batch queue (job records keyed by job name) and its version, which the
+// server patches with what changed since that version
+let queueJobs = new Map();
+let queueVersion = "0";
+
 // parallel program and cluster characteristics, all obtained from the server
 let pp_name;
 let pp_seqwork;
@@ -84,7 +112,7 @@ async function killServer() {
     let res = await fetch(`http://${serverAddress}/stop`, { method: 'POST'});
     document.getElementById('webapp').style.display = "none";
     document.getElementById('serverstopped').style.display = "";
-    clearInterval(updateClockTimer);
+    stopUpdatingClock();
 }
 
 // Function that returns the prompt string, with control characters for color
@@ -325,7 +353,7 @@ async function sendBatch(config) {
     }
 
     // Sends a POST request to the server to add a new job
-    let res = await fetch(`http://${serverAddress}/addJob`, { method: 'POST', body: JSON.stringify(body)});
+    let res = await fetchWithRetry(`http://${serverAddress}/addJob`, { method: 'POST', body: JSON.stringify(body)});
 
     // Parses the return value and decides what to generate/write
     res = await res.json();
@@ -350,7 +378,7 @@ async function cancelJob(jobName) {
     }
 
     // Sends the request asynchronously and parses as JSON
-    let res = await fetch(`http://${serverAddress}/cancelJob`, { method: 'POST', body: JSON.stringify(body)});
+    let res = await fetchWithRetry(`http://${serverAddress}/cancelJob`, { method: 'POST', body: JSON.stringify(body)});
     res = await res.json();
 
     // Prints the cancellation success
@@ -366,18 +394,31 @@ async function cancelJob(jobName) {
  */
 async function getQueue() {
     // Makes GET request to get the current queue
-    let res = await fetch(`http://${serverAddress}/getQueue`, { method: 'POST' });
+    let res = await fetchWithRetry(`http://${serverAddress}/getQueue?since=${encodeURIComponent(queueVersion)}`, { method: 'POST' });
     res = await res.json();
 
+    // Patch the local copy with what changed
+    if (res.full) {
+        queueJobs.clear();
+    }
+    for (const job of res.jobs) {
+        queueJobs.set(job.job, job);
+    }
+    for (const jobName of res.removed) {
+        queueJobs.delete(jobName);
+    }
+    queueVersion = res.version;
+    let queue = Array.from(queueJobs.values());
+
     // All running first, sorted by name (i.e., arrival time)
     // All pending next, sorted by name (i.e., arrival time)
-    res.queue.sort(function(a,b) {
-        let a_name = a.split(",")[1].split("_");
+    queue.sort(function(a,b) {
+        let a_name = a.job.split("_");
         a_name = parseInt(a_name[a_name.length -1]);
-        let b_name = b.split(",")[1].split("_");
+        let b_name = b.job.split("_");
         b_name = parseInt(b_name[b_name.length -1]);
-        let a_pending = parseInt(a.split(",")[4]) < 0;
-        let b_pending = parseInt(b.split(",")[4]) < 0;
+        let a_pending = a.start < 0;
+        let b_pending = b.start < 0;
 
         if (a_pending && !b_pending) {
             return 1;
@@ -398,19 +439,18 @@ async function getQueue() {
     term.write('\rJOBNAME   USER       NODES  START TIME      REQ TIME   STATUS\r\n');
 
 
-    for(const q of res.queue) {
+    for(const q of queue) {
         // Writes to terminal each job within the queue
-        let q_parse = q.split(",");
         // Sets job name which will display only 15 characters
-        let jobName = q_parse[1].split("_").slice(1).join("_").slice(0, 10);
+        let jobName = q.job.split("_").slice(1).join("_").slice(0, 10);
         // Sets user name which will display only 10 characters
-        let user = q_parse[0].slice(0, 10);
+        let user = q.user.slice(0, 10);
         // Sets up node count
-        let nodes = q_parse[2];
+        let nodes = String(q.nodes);
         // Sets up requested time
-        let rTime = q_parse[3];
+        let rTime = q.requested;
         // Sets the startTime to closest whole millisecond value
-        let startTime = Math.round(parseFloat(q_parse[4]));
+        let startTime = Math.round(q.start);
         // Sets up variable if startTime is not available since job isn't running
         let sTime = "n/a            "
         // Sets up variable which could change if job is running or not.
@@ -1173,34 +1213,22 @@ async function resetSimulation() {
     rewindArea.style.display = "";
 
     // Stop the periodic time query for now
-    clearInterval(updateClockTimer);
+    stopUpdatingClock();
     // clock.innerText = `12:00:00 AM`;
     // clock.innerText = ` `;
     term.setOption("disableStdin", true);
 
-    // Sends a POST request to the server
-    let res = await fetch(`http://${serverAddress}/reset`, { method: 'POST'});
-
-    // Sleep for 4s, which should be enough for the server to restart
-    await sleep(4000);
-
-    // Do a start again, with a 1-second retry, up to 10 times
-    for (let trial = 1; trial < 10; trial++) {
-        // Do a start again
-        try {
-            res = await fetch(`http://${serverAddress}/start`, {method: 'POST'});
-            console.log(res.status);
-        } catch (err) {
-            await fetch(`http://${serverAddress}/start`, {method: 'POST'});
-            await sleep(1000);
-            continue;
-        }
-        break;
-    }
+    // Sends a POST request to the server, which restarts its simulation on a session prepared on
+    // standby (requests sent in the meantime wait for the new simulation, no need to sleep). A start
+    // resets the simulation by itself: a reset before it would use up the standby session, and leave
+    // the start with one that is still being prepared.
+    let res = await fetch(`http://${serverAddress}/start`, {method: 'POST'});
 
-    // Reset the clock periodic activity
+    // Reset the clock periodic activity (the new simulation numbers its events from scratch)
     clock.innerText = `01/01 12:00:00 AM`;
-    updateClockTimer = setInterval(updateClockAndQueryServer, 1000);
+    eventCursor = 0;
+    queueVersion = "0";
+    startUpdatingClock();
 
     // Update file system
     filesystem.resetTime();
@@ -1258,17 +1286,54 @@ function initializeTerminal() {
     term.focus();
 }
 
+/**
+ * Sends a request to the server, and sends it again (a few times) after the delay the server asks
+ * for if the server turned it away because it was busy. Only such responses have a Retry-After
+ * header: other 503 responses (e.g., the simulation did not catch up with a time skip) are for
+ * requests that were carried out, and must not be sent again.
+ */
+async function fetchWithRetry(url, options) {
+    let res = await fetch(url, options);
+    for (let retry = 0; res.status === 503 && res.headers.has("Retry-After") && retry < maxShedRetries; retry++) {
+        let delay = parseFloat(res.headers.get("Retry-After")) || 1;
+        await new Promise(resolve => setTimeout(resolve, delay * 1000));
+        res = await fetch(url, options);
+    }
+    return res;
+}
+
 /**
  * Sends a get request to server to get current server simulated time and events which occurred.
+ * The server holds the request for up to queryWait milliseconds until some event occurs.
  */
 async function queryServer() {
-    let res = await fetch(`http://${serverAddress}/query`, { method: 'GET' });
+    let res = await fetchWithRetry(`http://${serverAddress}/query?wait=${queryWait}&after=${eventCursor}`, { method: 'GET' });
     res = await res.json();
-    handleEvents(res.events);
+    handleEventsAfterCursor(res);
+    if (res["speed"]) {
+        clockSpeed = res["speed"];
+    }
     // console.log("SERVER TOLD ME TIME = " + res["time"]);
     return res["time"];
 }
 
+/**
+ * Handles the events of a server response that are newer than the event cursor, and moves the
+ * cursor forward.
+ */
+function handleEventsAfterCursor(res) {
+    // Error responses may have no events
+    if (!Array.isArray(res.events)) {
+        return;
+    }
+    // A cursor going backwards means the server has restarted its simulation
+    if (res.truncated && res.cursor < eventCursor) {
+        eventCursor = 0;
+    }
+    handleEvents(res.events.filter(event => event.seq > eventCursor));
+    eventCursor = Math.max(eventCursor, res.cursor);
+}
+
 function convertTimeToUTC(seconds) {
     let t = new Date(0);
     t.setSeconds(seconds);
@@ -1284,29 +1349,25 @@ function convertTimeToUTC(seconds) {
 async function handleEvents(events) {
     // Loop through array of events
     for(const e of events) {
-        // Parse through event
+        // Each event is a record {seq, time, type, job, submit, start, end}
         //console.log(e);
-        let eParse = e.split(" ");
-        let time = Math.round(parseFloat(eParse[0]));
-        let status = eParse[1];
-        let jobName = eParse[3].slice(0, -1);
-        let jobSubmitDate = parseInt(eParse[eParse.length-1].split("|")[0]);
-        let jobStartDate = parseInt(eParse[eParse.length-1].split("|")[1]);
-        let jobFinishDate = parseInt(eParse[eParse.length-1].split("|")[2]);
-        jobSubmitDate = convertTimeToUTC(jobSubmitDate)
-        jobStartDate = convertTimeToUTC(jobStartDate)
-        jobFinishDate = convertTimeToUTC(jobFinishDate)
+        let time = Math.round(e.time);
+        let status = e.type;
+        let jobName = e.job;
+        let jobSubmitDate = convertTimeToUTC(Math.trunc(e.submit));
+        let jobStartDate = convertTimeToUTC(Math.trunc(e.start));
+        let jobFinishDate = convertTimeToUTC(Math.trunc(e.end));
 
         let fileContent = "";
         fileContent += jobSubmitDate + ": job submitted\n";
         fileContent += jobStartDate + ": job started\n";
         // Checks if job has been completed and creates a binary file representative of output file.
-        if(status === "StandardJobCompletedEvent") {
+        if(status === "completed") {
             let fileName = jobName.split("_").slice(1).join("_") + ".out";
             fileContent += jobFinishDate + ": job successfully completed";
             filesystem.createFile(fileName, time * 1000, false, true);
             filesystem.saveFile(fileName, fileContent);
-        } else if (status === "StandardJobFailedEvent") {
+        } else if (status === "failed") {
             let fileName = jobName.split("_").slice(1).join("_") + ".err";
             fileContent += jobFinishDate + ": job terminated due to time expiration";
             filesystem.createFile(fileName, time * 1000, false, true);
@@ -1342,33 +1403,126 @@ function updateClock() {
 }
 
 /**
- * Function called every second to update the clock and query the server.
+ * Function called every second to update the clock.
+ */
+function tickClock() {
+    // Increment simulation time by 1 (wall-clock) second
+    simTime.setTime(simTime.getTime() + 1000 * clockSpeed);
+    updateClock();
+}
+
+/**
+ * Queries the server over and over (each query waits on the server until some event occurs),
+ * and resynchronizes the clock with the server time after each query.
+ */
+async function pollServer() {
+    let generation = ++pollGeneration;
+    while (generation === pollGeneration) {
+        // Query server for current time
+        let serverTime;
+        try {
+            serverTime = await queryServer();
+        } catch (err) {
+            if (generation !== pollGeneration) {
+                return;
+            }
+            if (serverTerminated) {
+                document.getElementById('webapp').style.display = "none";
+                document.getElementById('serverstopped').style.display = "";
+            } else {
+                document.getElementById('webapp').style.display = "none";
+                document.getElementById('servererror').style.display = "";
+            }
+            stopUpdatingClock();
+            return;
+        }
+
+        if (generation === pollGeneration && Math.abs(serverTime - simTime.getTime()) > 500) {
+            simTime.setTime(serverTime);
+            updateClock();
+        }
+    }
+}
+
+/**
+ * Listens to the events and time updates pushed by the server, and resynchronizes the clock with
+ * the server time on each time update.
  */
-async function updateClockAndQueryServer() {
-    // Increment simulation time by 1 second
-    simTime.setTime(simTime.getTime() + 1000);
-
-    // Query server for current time
-    let serverTime;
-    try {
-        serverTime = await queryServer();
-    } catch (err) {
+function listenToServer() {
+    eventSourceErrors = 0;
+    eventSource = new EventSource(`http://${serverAddress}/events?after=${eventCursor}`);
+    eventSource.addEventListener("truncated", function(e) {
+        let res = JSON.parse(e.data);
+        if (res.cursor < eventCursor) {
+            eventCursor = 0;
+        }
+    });
+    eventSource.addEventListener("job", function(e) {
+        let event = JSON.parse(e.data);
+        if (event.seq <= eventCursor) {
+            return;
+        }
+        eventCursor = event.seq;
+        handleEvents([event]);
+    });
+    eventSource.addEventListener("time", function(e) {
+        eventSourceErrors = 0;
+        let res = JSON.parse(e.data);
+        clockSpeed = res["speed"];
+        if (Math.abs(res["time"] - simTime.getTime()) > 500) {
+            simTime.setTime(res["time"]);
+            updateClock();
+        }
+    });
+    eventSource.onerror = function() {
+        // The stream also ends when the server restarts for a reset, in which case we have stopped listening
+        if (eventSource === null) {
+            return;
+        }
+        // Let the browser reconnect (resuming from the last event received) after a transient error
+        if (eventSource.readyState === EventSource.CONNECTING && ++eventSourceErrors <= maxEventSourceErrors) {
+            return;
+        }
+        // The browser gives up on a stream the server turned away (e.g., because it was busy): poll
+        // the server instead, which reports an error if the server is actually gone
+        if (eventSource.readyState === EventSource.CLOSED && !serverTerminated) {
+            eventSource = null;
+            pollServer();
+            return;
+        }
+        document.getElementById('webapp').style.display = "none";
         if (serverTerminated) {
-            document.getElementById('webapp').style.display = "none";
             document.getElementById('serverstopped').style.display = "";
         } else {
-            document.getElementById('webapp').style.display = "none";
             document.getElementById('servererror').style.display = "";
         }
-        clearInterval(updateClockTimer);
-        return;
-    }
+        stopUpdatingClock();
+    };
+}
 
-    if(Math.abs(serverTime - simTime.getTime()) > 500) {
-        simTime.setTime(serverTime);
+/**
+ * Starts ticking the clock every second and listening to (or polling) the server.
+ */
+function startUpdatingClock() {
+    updateClockTimer = setInterval(tickClock, 1000);
+    if (window.EventSource) {
+        listenToServer();
+    } else {
+        pollServer();
     }
+}
 
-    updateClock();
+/**
+ * Stops ticking the clock and listening to (or polling) the server.
+ */
+function stopUpdatingClock() {
+    clearInterval(updateClockTimer);
+    pollGeneration++;
+    if (eventSource !== null) {
+        let source = eventSource;
+        eventSource = null;
+        source.close();
+    }
 }
 
 /**
@@ -1380,9 +1534,16 @@ async function addTime(numSeconds) {
     let body = {
         increment: numSeconds
     };
-    let res = await fetch(`http://${serverAddress}/addTime`, { method: 'POST', body: JSON.stringify(body)});
+    let res = await fetchWithRetry(`http://${serverAddress}/addTime?after=${eventCursor}`, { method: 'POST', body: JSON.stringify(body)});
+
+    // Only a response with events means that the server skipped the time (possibly without the
+    // simulation catching up), otherwise the local clock goes back to where it was
     res = await res.json();
-    handleEvents(res.events);
+    if (Array.isArray(res.events)) {
+        handleEventsAfterCursor(res);
+    } else {
+        simTime.setTime(simTime.getTime() - numSeconds * 1000);
+    }
     updateClock();
 }
 
@@ -1429,12 +1590,12 @@ async function main() {
             pp_seqwork = res["pp_seqwork"];
             pp_parwork = res["pp_parwork"];
             num_cluster_nodes = res["num_cluster_nodes"];
-            await sleep(5000); // ugly sleep
+            await sleep(res["num_seconds_to_sleep_before_anything"] * 1000);
             initializeTerminal();
             resetButton.style.display="";
             document.getElementById('starting').style.display="none";
             // Set up functions which need to be updated every specified interval
-            updateClockTimer = setInterval(updateClockAndQueryServer, 1000);
+            startUpdatingClock();
         });
 
 
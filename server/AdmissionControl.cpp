@@ -0,0 +1,217 @@
+#include "AdmissionControl.h"
+
+#include <sys/socket.h>
+
+#include <string>
+
+/**
+ * @brief Whether the current thread is the overflow thread of an AdmissionQueue.
+ */
+static thread_local bool overflow = false;
+
+/**
+ * @brief Number of connections handed to the overflow thread by all queues (there is one queue per
+ * listening server).
+ */
+static std::atomic<unsigned long> num_overflowed{0};
+
+
+/**
+ * @brief Construct a new pool of web server threads.
+ *
+ * @param num_threads Number of threads serving connections.
+ * @param max_queued Maximum number of connections waiting for a thread.
+ */
+AdmissionQueue::AdmissionQueue(size_t num_threads, size_t max_queued) : max_queued(max_queued) {
+    for (size_t i = 0; i < num_threads; i++) {
+        threads.emplace_back(&AdmissionQueue::work, this);
+    }
+    overflow_thread = std::thread(&AdmissionQueue::workOverflow, this);
+}
+
+/**
+ * @brief Queues a connection for the next available thread, or hands it to the overflow thread
+ * if too many connections are already waiting. If the overflow thread is itself too far behind,
+ * the connection is turned away by the calling (accepting) thread.
+ *
+ * @param fn Function serving the connection.
+ */
+void AdmissionQueue::enqueue(std::function<void()> fn) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (jobs.size() < max_queued) {
+            jobs.push_back(std::move(fn));
+            condition.notify_one();
+            return;
+        }
+        num_overflowed++;
+        if (overflow_jobs.size() < max_queued) {
+            overflow_jobs.push_back(std::move(fn));
+            overflow_condition.notify_one();
+            return;
+        }
+    }
+
+    // Turning a connection away is quick, hence the accepting thread is not held up for long
+    overflow = true;
+    fn();
+    overflow = false;
+}
+
+/**
+ * @brief Serves the queued connections and stops all threads.
+ */
+void AdmissionQueue::shutdown() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        shutting_down = true;
+    }
+    condition.notify_all();
+    overflow_condition.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    overflow_thread.join();
+}
+
+/**
+ * @brief Checks whether the current thread serves overflow connections, which are turned away.
+ *
+ * @return true if serving overflow connections.
+ */
+bool AdmissionQueue::isOverflow() {
+    return overflow;
+}
+
+/**
+ * @brief Retrieves the number of connections handed to the overflow thread so far.
+ *
+ * @return unsigned long Number of connections.
+ */
+unsigned long AdmissionQueue::getNumOverflowed() {
+    return num_overflowed;
+}
+
+/**
+ * @brief Main loop of the threads serving connections.
+ */
+void AdmissionQueue::work() {
+    while (true) {
+        std::function<void()> fn;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return not jobs.empty() or shutting_down; });
+            if (jobs.empty()) {
+                break;
+            }
+            fn = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        fn();
+    }
+}
+
+/**
+ * @brief Main loop of the overflow thread.
+ */
+void AdmissionQueue::workOverflow() {
+    overflow = true;
+    while (true) {
+        std::function<void()> fn;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            overflow_condition.wait(lock, [this] { return not overflow_jobs.empty() or shutting_down; });
+            if (overflow_jobs.empty()) {
+                break;
+            }
+            fn = std::move(overflow_jobs.front());
+            overflow_jobs.pop_front();
+        }
+        fn();
+    }
+}
+
+/**
+ * @brief Serves a connection, unless it was handed to the overflow thread, in which case it is
+ * turned away: a 503 response is written without reading the request, and the connection closed.
+ *
+ * @param sock Socket of the connection.
+ * @return true if the connection was served.
+ */
+bool AdmissionServer::process_and_close_socket(socket_t sock) {
+    if (not AdmissionQueue::isOverflow()) {
+        // Same as httplib::Server::process_and_close_socket(), which cannot be called from here
+        auto ret = httplib::detail::process_server_socket(
+                sock, keep_alive_max_count_, read_timeout_sec_, read_timeout_usec_,
+                write_timeout_sec_, write_timeout_usec_,
+                [this](httplib::Stream &strm, bool close_connection, bool &connection_closed) {
+                    return process_request(strm, close_connection, connection_closed, nullptr);
+                });
+        httplib::detail::shutdown_socket(sock);
+        httplib::detail::close_socket(sock);
+        return ret;
+    }
+
+    static const std::string body = "{\"error\":\"Server busy, retry later\"}";
+    static const std::string response =
+            "HTTP/1.1 503 Service Unavailable\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "Access-Control-Expose-Headers: Retry-After\r\n"
+            "Retry-After: 1\r\n"
+            "Connection: close\r\n"
+            "Content-Type: application/json\r\n"
+            "Content-Length: " + std::to_string(body.size()) + "\r\n"
+            "\r\n" + body;
+    send(sock, response.data(), response.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+
+    // Discard what the client already sent before closing, so that the connection is not reset
+    // (which may make the client drop the response)
+    shutdown(sock, SHUT_WR);
+    char buffer[4096];
+    while (recv(sock, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {}
+    httplib::detail::close_socket(sock);
+    return false;
+}
+
+/**
+ * @brief Construct a new request limiter.
+ *
+ * @param max_requests Maximum number of requests handled at the same time.
+ */
+RequestLimiter::RequestLimiter(size_t max_requests) : max_requests(max_requests) {}
+
+/**
+ * @brief Changes the maximum number of requests handled at the same time.
+ *
+ * @param new_max_requests Maximum number of requests.
+ */
+void RequestLimiter::setMaxRequests(size_t new_max_requests) {
+    max_requests = new_max_requests;
+}
+
+/**
+ * @brief Takes a slot for a request, without waiting.
+ *
+ * @return Slot The slot, or nullptr if all slots are taken.
+ */
+RequestLimiter::Slot RequestLimiter::tryAcquire() {
+    size_t current = num_requests.load();
+    do {
+        if (current >= max_requests) {
+            num_rejected++;
+            return nullptr;
+        }
+    } while (not num_requests.compare_exchange_weak(current, current + 1));
+
+    // The slot is only used for its deleter, hence any non-null pointer will do
+    return Slot(this, [](void *limiter) { static_cast<RequestLimiter *>(limiter)->num_requests--; });
+}
+
+/**
+ * @brief Retrieves the number of requests rejected so far because all slots were taken.
+ *
+ * @return unsigned long Number of requests.
+ */
+unsigned long RequestLimiter::getNumRejected() const {
+    return num_rejected;
+}
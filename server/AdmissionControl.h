@@ -0,0 +1,95 @@
+#ifndef ADMISSION_CONTROL_H
+#define ADMISSION_CONTROL_H
+
+#include "httplib.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+ * @brief Pool of web server threads with a bounded queue of connections waiting for a thread.
+ *
+ * Connections that do not fit in the queue are not left waiting: they are handed to a separate
+ * overflow thread (with a queue of the same bound, beyond which the accepting thread serves them
+ * itself), on which they are turned away right away (see AdmissionServer), so that an overloaded
+ * server answers quickly rather than not at all.
+ */
+class AdmissionQueue : public httplib::TaskQueue {
+public:
+
+    AdmissionQueue(size_t num_threads, size_t max_queued);
+
+    void enqueue(std::function<void()> fn) override;
+
+    void shutdown() override;
+
+    static bool isOverflow();
+
+    static unsigned long getNumOverflowed();
+
+private:
+
+    void work();
+
+    void workOverflow();
+
+    size_t max_queued;
+
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> jobs;
+
+    std::thread overflow_thread;
+    std::deque<std::function<void()>> overflow_jobs;
+
+    bool shutting_down = false;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::condition_variable overflow_condition;
+};
+
+/**
+ * @brief Web server that turns away the connections its AdmissionQueue hands to the overflow thread:
+ * it answers 503 with a Retry-After header without reading the request, and closes the connection.
+ */
+class AdmissionServer : public httplib::Server {
+private:
+
+    bool process_and_close_socket(socket_t sock) override;
+};
+
+/**
+ * @brief Limits the number of requests of some kind (e.g., those that wait for the simulation)
+ * that web server threads handle at the same time, so that they cannot tie up all threads.
+ */
+class RequestLimiter {
+public:
+
+    /**
+     * @brief Slot taken by a request, released when the last copy of the slot is destroyed (e.g.,
+     * when a streamed response is over).
+     */
+    using Slot = std::shared_ptr<void>;
+
+    explicit RequestLimiter(size_t max_requests = 1);
+
+    void setMaxRequests(size_t max_requests);
+
+    Slot tryAcquire();
+
+    unsigned long getNumRejected() const;
+
+private:
+
+    std::atomic<size_t> max_requests;
+    std::atomic<size_t> num_requests{0};
+    std::atomic<unsigned long> num_rejected{0};
+};
+
+#endif // ADMISSION_CONTROL_H
@@ -0,0 +1,294 @@
+#include "AssetCache.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#ifdef ENABLE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+
+/**
+ * @brief Compresses some data in the gzip format, at the highest compression level.
+ *
+ * @param data Data to compress.
+ * @return std::string Compressed data, or an empty string on failure.
+ */
+static std::string gzipCompress(const std::string &data) {
+    z_stream stream = {};
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 31, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return "";
+    }
+    std::string compressed(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = (Bytef *) data.data();
+    stream.avail_in = (uInt) data.size();
+    stream.next_out = (Bytef *) &compressed[0];
+    stream.avail_out = (uInt) compressed.size();
+    int ret = deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    return (ret == Z_STREAM_END ? compressed : "");
+}
+
+#ifdef ENABLE_BROTLI
+/**
+ * @brief Compresses some data in the brotli format, at the highest compression level.
+ *
+ * @param data Data to compress.
+ * @return std::string Compressed data, or an empty string on failure.
+ */
+static std::string brotliCompress(const std::string &data) {
+    size_t size = BrotliEncoderMaxCompressedSize(data.size());
+    if (size == 0) {
+        return "";
+    }
+    std::string compressed(size, '\0');
+    if (not BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+                                  data.size(), (const uint8_t *) data.data(),
+                                  &size, (uint8_t *) &compressed[0])) {
+        return "";
+    }
+    compressed.resize(size);
+    return compressed;
+}
+#endif
+
+/**
+ * @brief Checks whether an Accept-Encoding header allows some encoding (i.e., lists it without q=0).
+ *
+ * @param header Accept-Encoding header value.
+ * @param encoding Encoding name (e.g., "gzip").
+ * @return true if allowed.
+ */
+static bool acceptsEncoding(const std::string &header, const std::string &encoding) {
+    std::istringstream items(header);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        auto begin = item.find_first_not_of(' ');
+        if (begin == std::string::npos) {
+            continue;
+        }
+        auto end = item.find_first_of(" ;", begin);
+        if (item.compare(begin, end == std::string::npos ? std::string::npos : end - begin, encoding) != 0) {
+            continue;
+        }
+        auto q = item.find("q=", begin);
+        return q == std::string::npos or std::atof(item.c_str() + q + 2) > 0;
+    }
+    return false;
+}
+
+/**
+ * @brief Checks whether an If-None-Match header lists some entity tag, comparing each listed tag
+ * exactly and ignoring weak ("W/") prefixes.
+ *
+ * @param header If-None-Match header value.
+ * @param etag Entity tag, including its quotes.
+ * @return true if listed (or if the header is "*").
+ */
+static bool matchesEntityTag(const std::string &header, const std::string &etag) {
+    std::istringstream items(header);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        auto begin = item.find_first_not_of(" \t");
+        if (begin == std::string::npos) {
+            continue;
+        }
+        auto end = item.find_last_not_of(" \t");
+        std::string tag = item.substr(begin, end - begin + 1);
+        if (tag.compare(0, 2, "W/") == 0) {
+            tag.erase(0, 2);
+        }
+        if (tag == "*" or tag == etag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Files and directories of the client that the browser actually requests (sources and
+ * node_modules are only used to build bundle.js and libs/).
+ */
+static const std::vector<std::string> SERVED_ENTRIES = {"index.html", "index.css", "bundle.js", "libs"};
+
+/**
+ * @brief Loads the served client files from the first of some directories that exists.
+ *
+ * @param candidate_dirs Directories to try, in order.
+ * @return true if a directory was found, false otherwise.
+ */
+bool AssetCache::load(const std::vector<std::string> &candidate_dirs) {
+    for (const auto &dir : candidate_dirs) {
+        struct stat info;
+        if (stat(dir.c_str(), &info) == 0 and S_ISDIR(info.st_mode)) {
+            directory = dir;
+            assets.clear();
+            for (const auto &name : SERVED_ENTRIES) {
+                loadEntry(dir + "/" + name, "/" + name);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Loads a file, or the files of a directory and of its subdirectories.
+ *
+ * @param path Path of the file or directory.
+ * @param url_path URL path at which it is served.
+ */
+void AssetCache::loadEntry(const std::string &path, const std::string &url_path) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return;
+    }
+    if (S_ISDIR(info.st_mode)) {
+        DIR *handle = opendir(path.c_str());
+        if (handle == nullptr) {
+            return;
+        }
+        while (struct dirent *entry = readdir(handle)) {
+            std::string name = entry->d_name;
+            if (name != "." and name != ".." and name != "node_modules") {
+                loadEntry(path + "/" + name, url_path + "/" + name);
+            }
+        }
+        closedir(handle);
+        return;
+    }
+    if (not S_ISREG(info.st_mode)) {
+        return;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+
+    Asset asset;
+    asset.identity = content.str();
+    auto type = httplib::detail::find_content_type(path, {});
+    asset.content_type = (type ? type : "application/octet-stream");
+
+    // FNV-1a hash of the content, which changes whenever the file does
+    unsigned long long hash = 14695981039346656037ULL;
+    for (unsigned char c : asset.identity) {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    char etag[17];
+    std::snprintf(etag, sizeof(etag), "%016llx", hash);
+    asset.etag = etag;
+
+    // Only keep the compressed variants that are actually smaller
+    asset.gzip = gzipCompress(asset.identity);
+    if (asset.gzip.size() >= asset.identity.size()) {
+        asset.gzip.clear();
+    }
+#ifdef ENABLE_BROTLI
+    asset.brotli = brotliCompress(asset.identity);
+    if (asset.brotli.size() >= asset.identity.size()) {
+        asset.brotli.clear();
+    }
+#endif
+    assets[url_path] = std::move(asset);
+}
+
+/**
+ * @brief Serves a client file from memory, in the best encoding the browser accepts, or with a
+ * 304 if the browser already has the current version.
+ *
+ * @param req HTTP request object
+ * @param res HTTP response object
+ */
+void AssetCache::serve(const httplib::Request &req, httplib::Response &res) const {
+    std::string path = req.path;
+    if (path.empty() or path.back() == '/') {
+        path += "index.html";
+    }
+    auto it = assets.find(path);
+    if (it == assets.end()) {
+        res.status = 404;
+        return;
+    }
+    const auto &asset = it->second;
+
+    // Pick the smallest variant the browser accepts
+    const std::string *body = &asset.identity;
+    std::string encoding;
+    std::string accept_encoding = req.get_header_value("Accept-Encoding");
+    if (not asset.brotli.empty() and acceptsEncoding(accept_encoding, "br")) {
+        body = &asset.brotli;
+        encoding = "br";
+    } else if (not asset.gzip.empty() and acceptsEncoding(accept_encoding, "gzip")) {
+        body = &asset.gzip;
+        encoding = "gzip";
+    }
+
+    // Each variant has its own tag, but they all share the content hash
+    std::string etag = "\"" + asset.etag + (encoding.empty() ? "" : "-" + encoding) + "\"";
+    res.set_header("ETag", etag);
+    res.set_header("Cache-Control", "no-cache");
+    res.set_header("Vary", "Accept-Encoding");
+
+    if (matchesEntityTag(req.get_header_value("If-None-Match"), etag)) {
+        res.status = 304;
+        return;
+    }
+
+    if (not encoding.empty()) {
+        res.set_header("Content-Encoding", encoding);
+    }
+    res.set_content(*body, asset.content_type.c_str());
+}
+
+/**
+ * @brief Retrieves the directory the client files were loaded from.
+ */
+std::string AssetCache::getDirectory() const {
+    return directory;
+}
+
+/**
+ * @brief Retrieves the number of cached files.
+ */
+size_t AssetCache::getNumFiles() const {
+    return assets.size();
+}
+
+/**
+ * @brief Retrieves the total size of the cached files.
+ */
+size_t AssetCache::getSize() const {
+    size_t size = 0;
+    for (const auto &asset : assets) {
+        size += asset.second.identity.size();
+    }
+    return size;
+}
+
+/**
+ * @brief Retrieves the total size of the smallest compressed variant of each file (or of the
+ * file itself if it does not compress).
+ */
+size_t AssetCache::getCompressedSize() const {
+    size_t size = 0;
+    for (const auto &asset : assets) {
+        size_t smallest = asset.second.identity.size();
+        if (not asset.second.gzip.empty()) {
+            smallest = std::min(smallest, asset.second.gzip.size());
+        }
+        if (not asset.second.brotli.empty()) {
+            smallest = std::min(smallest, asset.second.brotli.size());
+        }
+        size += smallest;
+    }
+    return size;
+}
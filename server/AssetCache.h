@@ -0,0 +1,52 @@
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include "httplib.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+
+/**
+ * @brief In-memory copy of the served client files, loaded once at startup along with their gzip (and,
+ * if built with ENABLE_BROTLI, brotli) compressed variants, so that serving a page load never
+ * touches the disk nor compresses anything. Responses carry an ETag so that browsers revalidate
+ * their cached copy with a 304 rather than downloading the file again.
+ */
+class AssetCache {
+public:
+
+    bool load(const std::vector<std::string> &candidate_dirs);
+
+    void serve(const httplib::Request &req, httplib::Response &res) const;
+
+    std::string getDirectory() const;
+
+    size_t getNumFiles() const;
+
+    size_t getSize() const;
+
+    size_t getCompressedSize() const;
+
+private:
+
+    struct Asset {
+        std::string content_type;
+        std::string etag;
+        std::string identity;
+        std::string gzip;
+        std::string brotli;
+    };
+
+    void loadEntry(const std::string &path, const std::string &url_path);
+
+    /**
+     * @brief Cached files keyed by URL path (e.g., "/index.js").
+     */
+    std::map<std::string, Asset> assets;
+
+    std::string directory;
+};
+
+#endif // ASSET_CACHE_H
@@ -0,0 +1,205 @@
+#include "AsyncLogger.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <sstream>
+
+// Number of milliseconds between two flushes of the queued messages
+#define LOG_FLUSH_INTERVAL 50
+
+static const char *level_names[] = {"debug", "info", "warning", "error", "off"};
+static const char *category_names[] = {"request", "poll", "simulation", "server"};
+
+AsyncLogger server_log;
+
+
+/**
+ * @brief Construct a new logger, which queues messages until start() is called.
+ *
+ * @param capacity Maximum number of queued messages.
+ */
+AsyncLogger::AsyncLogger(size_t capacity) : entries(capacity) {
+    for (auto &level : levels) {
+        level = (int)LogLevel::Info;
+    }
+    levels[(int)LogCategory::Poll] = (int)LogLevel::Off;
+}
+
+AsyncLogger::~AsyncLogger() {
+    stop();
+}
+
+/**
+ * @brief Starts the background thread that writes out queued messages. Must be called in the
+ * process that logs (threads do not survive a fork).
+ */
+void AsyncLogger::start() {
+    std::lock_guard<std::mutex> lock(flusher_mutex);
+    if (running) {
+        return;
+    }
+    running = true;
+    flusher = std::thread(&AsyncLogger::run, this);
+}
+
+/**
+ * @brief Stops the background thread, if any, and writes out all queued messages.
+ */
+void AsyncLogger::stop() {
+    {
+        std::lock_guard<std::mutex> lock(flusher_mutex);
+        running = false;
+    }
+    flusher_condition.notify_all();
+    if (flusher.joinable()) {
+        flusher.join();
+    }
+    flush();
+}
+
+/**
+ * @brief Queues a printf-style message. Never blocks: the message is dropped if the queue is full.
+ *
+ * @param category Category of the message.
+ * @param level Level of the message.
+ * @param format printf-style format.
+ */
+void AsyncLogger::log(LogCategory category, LogLevel level, const char *format, ...) {
+    Entry entry;
+    entry.level = level;
+    entry.category = category;
+
+    va_list args;
+    va_start(args, format);
+    va_list args_copy;
+    va_copy(args_copy, args);
+    int length = std::vsnprintf(nullptr, 0, format, args_copy);
+    va_end(args_copy);
+    if (length > 0) {
+        entry.message.resize(length + 1);
+        std::vsnprintf(&entry.message[0], length + 1, format, args);
+        entry.message.resize(length);
+    }
+    va_end(args);
+
+    if (not entries.push(std::move(entry))) {
+        num_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Sets the minimum level of the messages logged in all categories.
+ *
+ * @param level Minimum level (LogLevel::Off to log nothing).
+ */
+void AsyncLogger::setLevel(LogLevel level) {
+    for (auto &category_level : levels) {
+        category_level = (int)level;
+    }
+}
+
+/**
+ * @brief Sets the minimum level of the messages logged in some category.
+ *
+ * @param category Category.
+ * @param level Minimum level (LogLevel::Off to log nothing).
+ */
+void AsyncLogger::setLevel(LogCategory category, LogLevel level) {
+    levels[(int)category] = (int)level;
+}
+
+/**
+ * @brief Sets the levels from a comma-separated list of "<level>" (for all categories) or
+ * "<category>=<level>" items, applied in order, e.g., "warning,request=info,poll=debug".
+ *
+ * @param specification List of levels.
+ * @return true on success, false if some item is invalid (the valid items before it are applied).
+ */
+bool AsyncLogger::configure(const std::string &specification) {
+    auto find_level = [](const std::string &name, LogLevel &level) {
+        for (int i = 0; i <= (int)LogLevel::Off; i++) {
+            if (name == level_names[i]) {
+                level = (LogLevel)i;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::istringstream items(specification);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        LogLevel level;
+        auto separator = item.find('=');
+        if (separator == std::string::npos) {
+            if (not find_level(item, level)) {
+                return false;
+            }
+            setLevel(level);
+            continue;
+        }
+        std::string category_name = item.substr(0, separator);
+        int category = 0;
+        while (category < (int)LogCategory::Count and category_name != category_names[category]) {
+            category++;
+        }
+        if (category == (int)LogCategory::Count or not find_level(item.substr(separator + 1), level)) {
+            return false;
+        }
+        setLevel((LogCategory)category, level);
+    }
+    return true;
+}
+
+/**
+ * @brief Retrieves the number of messages dropped because the queue was full.
+ *
+ * @return unsigned long Number of dropped messages.
+ */
+unsigned long AsyncLogger::getNumDropped() const {
+    return num_dropped.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Background thread, which periodically writes out the queued messages.
+ */
+void AsyncLogger::run() {
+    std::unique_lock<std::mutex> lock(flusher_mutex);
+    while (running) {
+        flusher_condition.wait_for(lock, std::chrono::milliseconds(LOG_FLUSH_INTERVAL));
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+/**
+ * @brief Writes out the queued messages: warnings and errors to the standard error, the others
+ * to the standard output.
+ */
+void AsyncLogger::flush() {
+    Entry entry;
+    bool written = false;
+    while (entries.pop(entry)) {
+        FILE *stream = (entry.level >= LogLevel::Warning ? stderr : stdout);
+        std::fprintf(stream, "[%s] %s: %s\n", level_names[(int)entry.level],
+                     category_names[(int)entry.category], entry.message.c_str());
+        written = true;
+    }
+
+    unsigned long dropped = num_dropped.load(std::memory_order_relaxed);
+    if (dropped != num_reported_dropped) {
+        std::fprintf(stderr, "[warning] server: %lu log messages dropped\n", dropped - num_reported_dropped);
+        num_reported_dropped = dropped;
+        written = true;
+    }
+
+    if (written) {
+        std::fflush(stdout);
+        std::fflush(stderr);
+    }
+}
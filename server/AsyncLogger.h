@@ -0,0 +1,118 @@
+#ifndef ASYNC_LOGGER_H
+#define ASYNC_LOGGER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "ring_buffer.h"
+
+
+/**
+ * @brief Severity of a log message. Messages below the level of their category are discarded.
+ */
+enum class LogLevel : int {
+    Debug = 0,
+    Info,
+    Warning,
+    Error,
+    Off
+};
+
+/**
+ * @brief What a log message is about, so that each kind of message can be filtered on its own.
+ */
+enum class LogCategory : int {
+    // Requests that change the simulation (jobs, time skips, start/stop...)
+    Request = 0,
+    // Requests that clients send continuously (time, queries, event streams, queue), off by default
+    Poll,
+    // Job submissions and events in the simulation thread
+    Simulation,
+    // Server lifecycle and statistics
+    Server,
+    Count
+};
+
+/**
+ * @brief Logger that never blocks the threads that log: messages are formatted by the caller,
+ * queued in a lock-free ring buffer and written out by a background thread. Messages are dropped
+ * (and counted) if the ring buffer is full.
+ *
+ * Use the SERVER_LOG macro, which skips formatting altogether when the message would be discarded.
+ */
+class AsyncLogger {
+public:
+
+    explicit AsyncLogger(size_t capacity = 4096);
+
+    ~AsyncLogger();
+
+    void start();
+
+    void stop();
+
+    /**
+     * @brief Checks whether messages of some category and level are logged.
+     */
+    bool isEnabled(LogCategory category, LogLevel level) const {
+        return (int)level >= levels[(int)category].load(std::memory_order_relaxed) and level != LogLevel::Off;
+    }
+
+    void log(LogCategory category, LogLevel level, const char *format, ...) __attribute__((format(printf, 4, 5)));
+
+    void setLevel(LogLevel level);
+
+    void setLevel(LogCategory category, LogLevel level);
+
+    bool configure(const std::string &specification);
+
+    unsigned long getNumDropped() const;
+
+private:
+
+    struct Entry {
+        LogLevel level;
+        LogCategory category;
+        std::string message;
+    };
+
+    void run();
+
+    void flush();
+
+    wrench::RingBuffer<Entry> entries;
+
+    /**
+     * @brief Minimum level of the messages logged, per category.
+     */
+    std::atomic<int> levels[(int)LogCategory::Count];
+
+    std::atomic<unsigned long> num_dropped{0};
+    unsigned long num_reported_dropped = 0;
+
+    std::thread flusher;
+    std::mutex flusher_mutex;
+    std::condition_variable flusher_condition;
+    bool running = false;
+};
+
+/**
+ * @brief Logger of this server session.
+ */
+extern AsyncLogger server_log;
+
+/**
+ * @brief Logs a printf-style message, e.g., SERVER_LOG(Request, Info, "%s", path), without
+ * evaluating the arguments if the category is not logged at that level.
+ */
+#define SERVER_LOG(category, level, ...) \
+    do { \
+        if (server_log.isEnabled(LogCategory::category, LogLevel::level)) \
+            server_log.log(LogCategory::category, LogLevel::level, __VA_ARGS__); \
+    } while (0)
+
+#endif // ASYNC_LOGGER_H
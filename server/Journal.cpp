@@ -0,0 +1,238 @@
+#include "Journal.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+
+
+Journal::~Journal() {
+    if (file != nullptr) {
+        fclose(file);
+    }
+}
+
+/**
+ * @brief Opens (or creates) the journal file. Lines are appended to what it already contains.
+ *
+ * @param path Path of the file.
+ * @return true on success, false otherwise.
+ */
+bool Journal::open(const std::string &path) {
+    std::unique_lock<std::mutex> lock(mutex);
+    this->path = path;
+    file = fopen(path.c_str(), "a+");
+    return file != nullptr;
+}
+
+/**
+ * @brief Checks whether the journal is open, i.e., whether actions are recorded.
+ *
+ * @return true if open.
+ */
+bool Journal::isOpen() const {
+    std::unique_lock<std::mutex> lock(mutex);
+    return file != nullptr;
+}
+
+/**
+ * @brief Reads what the journal file contains.
+ *
+ * @return std::string Content of the file (empty if the journal is not open).
+ */
+std::string Journal::getContent() {
+    std::unique_lock<std::mutex> lock(mutex);
+    std::string content;
+    if (file == nullptr) {
+        return content;
+    }
+    fflush(file);
+    rewind(file);
+    char buffer[4096];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        content.append(buffer, size);
+    }
+    return content;
+}
+
+/**
+ * @brief Empties the journal, e.g., when the user resets the simulation.
+ */
+void Journal::clear() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (file == nullptr) {
+        return;
+    }
+    fflush(file);
+    if (ftruncate(fileno(file), 0) != 0) {
+        perror("Cannot clear journal");
+    }
+    last_time = 0;
+    num_jobs = 0;
+    job_indices.clear();
+}
+
+/**
+ * @brief Moves the journal file aside (e.g., so that a journal that makes the server crash can be
+ * looked into), and starts a new, empty one.
+ *
+ * @param suffix Suffix appended to the path of the file moved aside.
+ * @return true on success, false otherwise (the journal is then emptied instead).
+ */
+bool Journal::setAside(const std::string &suffix) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (file == nullptr) {
+        return false;
+    }
+    fclose(file);
+    bool moved = rename(path.c_str(), (path + suffix).c_str()) == 0;
+    file = fopen(path.c_str(), moved ? "a+" : "w+");
+    last_time = 0;
+    num_jobs = 0;
+    job_indices.clear();
+    return moved and file != nullptr;
+}
+
+/**
+ * @brief Records the seed of the random number generator used to generate the background jobs.
+ *
+ * @param seed Seed
+ */
+void Journal::recordSeed(unsigned int seed) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (file == nullptr) {
+        return;
+    }
+    fprintf(file, "# seed %u\n", seed);
+    fflush(file);
+}
+
+/**
+ * @brief Records a job submission (sbatch line). Jobs that could not be added are ignored, since
+ * whether they can be added may differ when replaying.
+ *
+ * @param time Simulated time in seconds.
+ * @param job_name Name of the job, or an empty string if it could not be added.
+ * @param num_nodes Number of nodes.
+ * @param requested_duration Requested duration in seconds.
+ */
+void Journal::recordJob(double time, const std::string &job_name, int num_nodes, double requested_duration) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (file == nullptr or job_name.empty()) {
+        return;
+    }
+    num_jobs++;
+    job_indices[job_name] = num_jobs;
+    fprintf(file, "%.17g sbatch %d %.17g\n", writeTime(time), num_nodes, requested_duration);
+    fflush(file);
+}
+
+/**
+ * @brief Records a job cancellation (scancel line). Jobs not submitted by the user are ignored.
+ *
+ * @param time Simulated time in seconds.
+ * @param job_name Name of the job.
+ */
+void Journal::recordCancel(double time, const std::string &job_name) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = job_indices.find(job_name);
+    if (file == nullptr or it == job_indices.end()) {
+        return;
+    }
+    fprintf(file, "%.17g scancel %zu\n", writeTime(time), it->second);
+    fflush(file);
+}
+
+/**
+ * @brief Records a time skip (skip line).
+ *
+ * @param time Simulated time in seconds before the skip.
+ * @param increment Number of seconds skipped.
+ */
+void Journal::recordSkip(double time, double increment) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (file == nullptr or increment <= 0) {
+        return;
+    }
+    time = writeTime(time);
+    fprintf(file, "%.17g skip %.17g\n", time, increment);
+    last_time = time + increment;
+    fflush(file);
+}
+
+/**
+ * @brief Accounts for a job submitted while replaying the journal, whose sbatch line is already in
+ * the file, so that later lines refer to it properly. Must be called in sbatch line order.
+ *
+ * @param job_name Name of the job, or an empty string if it could not be added.
+ */
+void Journal::restoreJob(const std::string &job_name) {
+    std::unique_lock<std::mutex> lock(mutex);
+    num_jobs++;
+    if (not job_name.empty()) {
+        job_indices[job_name] = num_jobs;
+    }
+}
+
+/**
+ * @brief Records that the journal is about to be replayed, so that the next session can tell whether
+ * the replay (or what follows it) made the server crash before any new action was recorded.
+ */
+void Journal::recordReplay() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (file == nullptr) {
+        return;
+    }
+    fprintf(file, "# replay\n");
+    fflush(file);
+}
+
+/**
+ * @brief Retrieves the random number generator seed recorded in a journal.
+ *
+ * @param content Content of the journal.
+ * @param seed Set to the seed, if found.
+ * @return true if a seed was found.
+ */
+bool Journal::parseSeed(const std::string &content, unsigned int &seed) {
+    std::istringstream lines(content);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (sscanf(line.c_str(), "# seed %u", &seed) == 1) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Checks whether a journal was already replayed, and no action was recorded since (see
+ * recordReplay()), in which case replaying it again would most likely crash again.
+ *
+ * @param content Content of the journal.
+ * @return true if the last line of the journal is a replay line.
+ */
+bool Journal::isReplayPending(const std::string &content) {
+    std::istringstream lines(content);
+    std::string line;
+    std::string last_line;
+    while (std::getline(lines, line)) {
+        if (not line.empty()) {
+            last_line = line;
+        }
+    }
+    return last_line == "# replay";
+}
+
+/**
+ * @brief Makes sure lines are written in non-decreasing time order (requests recorded concurrently
+ * may read the time in a different order than they are recorded). Must be called with the mutex.
+ *
+ * @param time Simulated time of the line in seconds.
+ * @return double Time to write.
+ */
+double Journal::writeTime(double time) {
+    last_time = std::max(last_time, time);
+    return last_time;
+}
@@ -0,0 +1,70 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+
+
+/**
+ * @brief On-disk journal of the actions that changed the state of a session, written in the format
+ * of headless scripts (see runHeadless()) so that a session that crashed can be rebuilt by running
+ * its journal as fast as possible. Each line is flushed when written, and lines are written in
+ * non-decreasing simulated time order. Safe to use from all web server threads.
+ */
+class Journal {
+public:
+
+    ~Journal();
+
+    bool open(const std::string &path);
+
+    bool isOpen() const;
+
+    std::string getContent();
+
+    void clear();
+
+    bool setAside(const std::string &suffix);
+
+    void recordSeed(unsigned int seed);
+
+    void recordJob(double time, const std::string &job_name, int num_nodes, double requested_duration);
+
+    void recordCancel(double time, const std::string &job_name);
+
+    void recordSkip(double time, double increment);
+
+    void restoreJob(const std::string &job_name);
+
+    void recordReplay();
+
+    static bool parseSeed(const std::string &content, unsigned int &seed);
+
+    static bool isReplayPending(const std::string &content);
+
+private:
+
+    double writeTime(double time);
+
+    mutable std::mutex mutex;
+
+    FILE *file = nullptr;
+
+    std::string path;
+
+    /**
+     * @brief Simulated time of the latest line, which later lines are never before.
+     */
+    double last_time = 0;
+
+    /**
+     * @brief Number of sbatch lines, and index of the sbatch line of each job (starting at 1, as
+     * expected by scancel lines) keyed by job name.
+     */
+    size_t num_jobs = 0;
+    std::map<std::string, size_t> job_indices;
+};
+
+#endif // JOURNAL_H
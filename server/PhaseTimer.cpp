@@ -0,0 +1,102 @@
+#include "PhaseTimer.h"
+
+#include <cstdio>
+
+
+/**
+ * @brief Retrieves the current time, to pass as the beginning of the first phase.
+ *
+ * @return TimePoint Current time.
+ */
+PhaseTimer::TimePoint PhaseTimer::now() {
+    return std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief Records a phase that ends now.
+ *
+ * @param phase Name of the phase.
+ * @param begin Time at which the phase began.
+ * @return TimePoint Current time, i.e., the beginning of the next phase.
+ */
+PhaseTimer::TimePoint PhaseTimer::record(const std::string &phase, TimePoint begin) {
+    auto end = now();
+    std::unique_lock<std::mutex> lock(mutex);
+    phases.emplace_back(phase, std::chrono::duration<double, std::milli>(end - begin).count());
+    return end;
+}
+
+/**
+ * @brief Records a phase spent idle (e.g., waiting to be activated) that ends now. It is reported
+ * separately, and not counted in the total.
+ *
+ * @param phase Name of the phase.
+ * @param begin Time at which the phase began.
+ * @return TimePoint Current time, i.e., the beginning of the next phase.
+ */
+PhaseTimer::TimePoint PhaseTimer::recordWait(const std::string &phase, TimePoint begin) {
+    auto end = now();
+    std::unique_lock<std::mutex> lock(mutex);
+    waits.emplace_back(phase, std::chrono::duration<double, std::milli>(end - begin).count());
+    return end;
+}
+
+/**
+ * @brief Retrieves the phases recorded so far.
+ *
+ * @return std::vector<std::pair<std::string, double>> Phase names and durations in milliseconds.
+ */
+std::vector<std::pair<std::string, double>> PhaseTimer::getPhases() const {
+    std::unique_lock<std::mutex> lock(mutex);
+    return phases;
+}
+
+/**
+ * @brief Retrieves the idle phases recorded so far.
+ *
+ * @return std::vector<std::pair<std::string, double>> Phase names and durations in milliseconds.
+ */
+std::vector<std::pair<std::string, double>> PhaseTimer::getWaits() const {
+    std::unique_lock<std::mutex> lock(mutex);
+    return waits;
+}
+
+/**
+ * @brief Retrieves the total duration of the phases recorded so far, except idle ones.
+ *
+ * @return double Duration in milliseconds.
+ */
+double PhaseTimer::getTotal() const {
+    std::unique_lock<std::mutex> lock(mutex);
+    double total = 0;
+    for (const auto &phase : phases) {
+        total += phase.second;
+    }
+    return total;
+}
+
+/**
+ * @brief Formats the phases recorded so far on one line, e.g., "init 1.20 ms, platform 3.40 ms
+ * (waits: standby 500.00 ms)".
+ *
+ * @return std::string Formatted phases.
+ */
+std::string PhaseTimer::toString() const {
+    std::unique_lock<std::mutex> lock(mutex);
+    std::string line;
+    for (const auto &phase : phases) {
+        char duration[32];
+        std::snprintf(duration, sizeof(duration), " %.2f ms", phase.second);
+        line += (line.empty() ? "" : ", ") + phase.first + duration;
+    }
+    std::string wait_line;
+    for (const auto &wait : waits) {
+        char duration[32];
+        std::snprintf(duration, sizeof(duration), " %.2f ms", wait.second);
+        wait_line += (wait_line.empty() ? "" : ", ") + wait.first + duration;
+    }
+    if (not wait_line.empty()) {
+        line += (line.empty() ? "(waits: " : " (waits: ") + wait_line + ")";
+    }
+    return line;
+}
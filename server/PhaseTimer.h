@@ -0,0 +1,51 @@
+#ifndef PHASE_TIMER_H
+#define PHASE_TIMER_H
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+/**
+ * @brief Durations of the successive phases of some process (e.g., starting a session), measured
+ * with a monotonic high-resolution clock, so that regressions can be tracked phase by phase. Safe
+ * to use from several threads.
+ */
+class PhaseTimer {
+public:
+
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    static TimePoint now();
+
+    TimePoint record(const std::string &phase, TimePoint begin);
+
+    TimePoint recordWait(const std::string &phase, TimePoint begin);
+
+    std::vector<std::pair<std::string, double>> getPhases() const;
+
+    std::vector<std::pair<std::string, double>> getWaits() const;
+
+    double getTotal() const;
+
+    std::string toString() const;
+
+private:
+
+    mutable std::mutex mutex;
+
+    /**
+     * @brief Phase names and durations in milliseconds, in the order they were recorded.
+     */
+    std::vector<std::pair<std::string, double>> phases;
+
+    /**
+     * @brief Names and durations in milliseconds of the phases spent idle (e.g., waiting to be
+     * activated), which are not part of the total.
+     */
+    std::vector<std::pair<std::string, double>> waits;
+};
+
+#endif // PHASE_TIMER_H
@@ -0,0 +1,142 @@
+#include "SimulationClock.h"
+
+#include <chrono>
+
+// Current monotonic wall-clock time in milliseconds
+#define get_time() (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count())
+
+
+/**
+ * @brief Construct a new, not yet started, simulation clock.
+ *
+ * @param speed Number of simulated seconds per wall-clock second.
+ */
+SimulationClock::SimulationClock(double speed) : speed(speed) {}
+
+/**
+ * @brief Starts (or restarts) the clock at simulated time zero.
+ */
+void SimulationClock::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    wall_base = get_time();
+    simulated_base = 0;
+    started = true;
+    paused = false;
+}
+
+/**
+ * @brief Checks whether the clock has been started.
+ *
+ * @return true if started.
+ */
+bool SimulationClock::isStarted() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return started;
+}
+
+/**
+ * @brief Retrieves the current simulated time.
+ *
+ * @return time_t Simulated time in milliseconds.
+ */
+time_t SimulationClock::now() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return nowLocked();
+}
+
+/**
+ * @brief Moves the clock forward, e.g., when the user skips time.
+ *
+ * @param increment Number of simulated milliseconds to add.
+ */
+void SimulationClock::advance(time_t increment) {
+    std::lock_guard<std::mutex> lock(mutex);
+    simulated_base += increment;
+}
+
+/**
+ * @brief Moves the clock forward to some simulated time, if it is not already past it.
+ *
+ * @param time Simulated time in milliseconds.
+ */
+void SimulationClock::advanceTo(time_t time) {
+    std::lock_guard<std::mutex> lock(mutex);
+    time_t current = nowLocked();
+    if (time > current) {
+        simulated_base += time - current;
+    }
+}
+
+/**
+ * @brief Changes the speed of the clock from now on.
+ *
+ * @param new_speed Number of simulated seconds per wall-clock second.
+ */
+void SimulationClock::setSpeed(double new_speed) {
+    std::lock_guard<std::mutex> lock(mutex);
+    rebase();
+    speed = new_speed;
+}
+
+/**
+ * @brief Stops the simulated time from elapsing until resume() is called. Time can still be
+ * moved forward with advance() while paused.
+ */
+void SimulationClock::pause() {
+    std::lock_guard<std::mutex> lock(mutex);
+    rebase();
+    paused = true;
+}
+
+/**
+ * @brief Lets the simulated time elapse again after pause().
+ */
+void SimulationClock::resume() {
+    std::lock_guard<std::mutex> lock(mutex);
+    rebase();
+    paused = false;
+}
+
+/**
+ * @brief Checks whether the clock is paused.
+ *
+ * @return true if paused.
+ */
+bool SimulationClock::isPaused() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return paused;
+}
+
+/**
+ * @brief Retrieves the speed of the clock.
+ *
+ * @return double Number of simulated seconds per wall-clock second.
+ */
+double SimulationClock::getSpeed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return speed;
+}
+
+/**
+ * @brief Computes the current simulated time. Must be called with the mutex held.
+ *
+ * @return time_t Simulated time in milliseconds.
+ */
+time_t SimulationClock::nowLocked() const {
+    if (paused) {
+        return simulated_base;
+    }
+    return simulated_base + (time_t)((double)(get_time() - wall_base) * speed);
+}
+
+/**
+ * @brief Folds the simulated time elapsed so far into the base, so that the speed can change
+ * without making the simulated time jump. Must be called with the mutex held.
+ */
+void SimulationClock::rebase() {
+    time_t wall_now = get_time();
+    if (not paused) {
+        simulated_base += (time_t)((double)(wall_now - wall_base) * speed);
+    }
+    wall_base = wall_now;
+}
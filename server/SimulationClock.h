@@ -0,0 +1,67 @@
+#ifndef SIMULATION_CLOCK_H
+#define SIMULATION_CLOCK_H
+
+#include <ctime>
+#include <mutex>
+
+
+/**
+ * @brief Server simulated clock, in milliseconds since the simulation started, which runs
+ * at some (runtime-adjustable) multiple of wall-clock time, and can be paused. It is based on
+ * a monotonic clock so that wall-clock adjustments (e.g., NTP) do not affect simulated time,
+ * and is safe to use from all web server threads.
+ */
+class SimulationClock {
+public:
+
+    explicit SimulationClock(double speed = 1.0);
+
+    void start();
+
+    bool isStarted() const;
+
+    time_t now() const;
+
+    void advance(time_t increment);
+
+    void advanceTo(time_t time);
+
+    void setSpeed(double new_speed);
+
+    double getSpeed() const;
+
+    void pause();
+
+    void resume();
+
+    bool isPaused() const;
+
+private:
+
+    time_t nowLocked() const;
+
+    void rebase();
+
+    mutable std::mutex mutex;
+
+    /**
+     * @brief Wall-clock time in milliseconds at which the simulated time was last rebased.
+     */
+    time_t wall_base = 0;
+
+    /**
+     * @brief Simulated time in milliseconds at the last rebase.
+     */
+    time_t simulated_base = 0;
+
+    /**
+     * @brief Number of simulated milliseconds per wall-clock millisecond.
+     */
+    double speed;
+
+    bool started = false;
+
+    bool paused = false;
+};
+
+#endif // SIMULATION_CLOCK_H
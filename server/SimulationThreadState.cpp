@@ -5,6 +5,8 @@
 #include <unistd.h>
 
 #include <cstdio>
+#include <cstdlib>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -12,16 +14,27 @@
 #include <wrench.h>
 
 
+/**
+ * @brief Private directory holding the platform files written by this process (and by its parent).
+ */
+static std::string platform_dir;
+
+/**
+ * @brief Platform files already written, keyed by number of nodes and of cores per node.
+ */
+static std::map<std::pair<int, int>, std::string> platform_files;
+
 /**
  * @brief Creates and writes the XML config file to be used by wrench to configure simgrid.
  *
+ * @param path Path of the file.
  * @param nodes Number of nodes to be simulated.
  * @param cores Number of cores per node to be simulated.
  */
-void write_xml(int nodes, int cores)
+void write_xml(const std::string &path, int nodes, int cores)
 {
     std::ofstream outputXML;
-    outputXML.open("config.xml");
+    outputXML.open(path);
     outputXML << "<?xml version='1.0'?>\n";
     outputXML << "<!DOCTYPE platform SYSTEM \"http://simgrid.gforge.inria.fr/simgrid/simgrid.dtd\">\n";
     outputXML << "<platform version=\"4.1\">\n";
@@ -180,9 +193,11 @@ std::vector<std::tuple<int, int>> createTraceFile(std::string path, std::string
 
 
 void SimulationThreadState::createAndLaunchSimulation(int main_argc, char **main_argv, int num_nodes, int num_cores,
-                                                      std::string tracefile_scheme) {
+                                                      std::string tracefile_scheme, bool event_driven_advance) {
     static bool never_called = true;
 
+    auto phase_begin = PhaseTimer::now();
+
     // Make a copy of argc and argv
     int argc = main_argc;
     char **argv = (char **) calloc(main_argc, sizeof(char *));
@@ -190,17 +205,20 @@ void SimulationThreadState::createAndLaunchSimulation(int main_argc, char **main
         argv[i] = (char *) calloc(strlen(main_argv[i]) + 1, sizeof(char));
         strcpy(argv[i], main_argv[i]);
     }
+    phase_begin = startup_phases.record("argv copy", phase_begin);
 
 
     // Let WRENCH grab its own command-line arguments, if any
     simulation.init(&argc, argv);
+    phase_begin = startup_phases.record("init", phase_begin);
 
-    // XML generated then read
-    write_xml(num_nodes, num_cores);
-    std::string simgrid_config = "config.xml";
+    // XML generated (unless already cached) then read
+    std::string simgrid_config = getPlatformFile(num_nodes, num_cores);
+    phase_begin = startup_phases.record("platform file", phase_begin);
 
     // Instantiate Simulated Platform
     simulation.instantiatePlatform(simgrid_config);
+    phase_begin = startup_phases.record("platform", phase_begin);
 
 
     // Generate vector containing variable number of compute nodes
@@ -222,7 +240,9 @@ void SimulationThreadState::createAndLaunchSimulation(int main_argc, char **main
     } else {
 //        std::string path_to_tracefile = "/tmp/tracefile.swf";
         std::string path_to_tracefile = ""; // No trace file!
+        phase_begin = startup_phases.record("storage service", phase_begin);
         background_jobs = createTraceFile(path_to_tracefile, tracefile_scheme, num_nodes);
+        phase_begin = startup_phases.record("trace", phase_begin);
         auto raw_ptr = new wrench::BatchComputeService("ComputeNode_0", nodes, "",
                                                        {{wrench::BatchComputeServiceProperty::BATCH_SCHEDULING_ALGORITHM, "conservative_bf"}},
 //                                                    {wrench::BatchComputeServiceProperty::SIMULATED_WORKLOAD_TRACE_FILE, path_to_tracefile}
@@ -231,12 +251,27 @@ void SimulationThreadState::createAndLaunchSimulation(int main_argc, char **main
 
     }
 
+    phase_begin = startup_phases.record(tracefile_scheme == "none" ? "services" : "batch service", phase_begin);
+
+    wms_mutex.lock();
     this->wms = simulation.add(
-            new wrench::WorkflowManager({batch_service}, {storage_service}, "WMSHost", nodes.size(), num_cores, background_jobs));
+            new wrench::WorkflowManager({batch_service}, {storage_service}, "WMSHost", nodes.size(), num_cores, background_jobs,
+                                        event_driven_advance));
+    wms_mutex.unlock();
+    wms_created.notify_all();
 
     // Add workflow to wms
     wrench::Workflow workflow;
     this->wms->addWorkflow(&workflow);
+    phase_begin = startup_phases.record("wms", phase_begin);
+
+    // Wait until told to go if on standby
+    {
+        std::unique_lock<std::mutex> lock(wms_mutex);
+        launch_released.wait(lock, [this] { return not launch_held; });
+        launch_begin = PhaseTimer::now();
+    }
+    startup_phases.recordWait("launch hold", phase_begin);
 
     // Start the simulation. Currently cannot start the simulation in a different thread or else it will
     // seg fault. Most likely related to how simgrid handles threads so the web server has to started
@@ -244,8 +279,41 @@ void SimulationThreadState::createAndLaunchSimulation(int main_argc, char **main
     simulation.launch();
 }
 
-void SimulationThreadState::getEventStatuses(queue<std::string> &statuses, const time_t &time) const {
-    this->wms->getEventStatuses(statuses, time);
+unsigned long SimulationThreadState::getEventStatuses(queue<wrench::JobEvent> &statuses) const {
+    return this->wms->getEventStatuses(statuses);
+}
+
+unsigned long SimulationThreadState::getEventStatuses(queue<wrench::JobEvent> &statuses, unsigned long after,
+                                                      bool &truncated) const {
+    return this->wms->getEventStatuses(statuses, after, truncated);
+}
+
+unsigned long SimulationThreadState::setServerTime(const double &time) const {
+    return this->wms->setServerTime(time);
+}
+
+bool SimulationThreadState::waitForAdvance(unsigned long sequence, double timeout) const {
+    return this->wms->waitForAdvance(sequence, timeout);
+}
+
+bool SimulationThreadState::waitForEvents(double timeout) const {
+    return this->wms->waitForEvents(timeout);
+}
+
+bool SimulationThreadState::waitForEvents(unsigned long after, double timeout) const {
+    return this->wms->waitForEvents(after, timeout);
+}
+
+bool SimulationThreadState::isStopping() const {
+    return this->wms->isStopping();
+}
+
+unsigned long SimulationThreadState::advanceToNextJobEvent(double max_time) const {
+    return this->wms->advanceToNextJobEvent(max_time);
+}
+
+bool SimulationThreadState::hasPendingJobs() const {
+    return this->wms->hasPendingJobs();
 }
 
 std::string SimulationThreadState::addJob(const double& requested_duration,
@@ -253,6 +321,10 @@ std::string SimulationThreadState::addJob(const double& requested_duration,
     return this->wms->addJob(requested_duration, num_nodes, actual_duration);
 }
 
+std::vector<std::string> SimulationThreadState::addJobs(const std::vector<std::tuple<double, unsigned int, double>>& job_specs) const {
+    return this->wms->addJobs(job_specs);
+}
+
 bool SimulationThreadState::cancelJob(const std::string& job_name) const {
     return this->wms->cancelJob(job_name);
 }
@@ -261,10 +333,145 @@ void SimulationThreadState::stopSimulation() const {
     this->wms->stopServer();
 }
 
-std::vector<std::string> SimulationThreadState::getQueue() const {
-    return this->wms->getQueue();
+std::shared_ptr<const wrench::QueueSnapshot> SimulationThreadState::getQueueSnapshot() const {
+    return this->wms->getQueueSnapshot();
+}
+
+std::shared_ptr<const wrench::QueueSnapshot> SimulationThreadState::findQueueSnapshot(unsigned long version) const {
+    return this->wms->findQueueSnapshot(version);
+}
+
+/**
+ * @brief Waits until the simulation has been launched and its WMS is ready to accept jobs.
+ *
+ * @param timeout Maximum time to wait in seconds.
+ * @return true if the WMS is ready, false if the timeout expired.
+ */
+bool SimulationThreadState::waitUntilReady(double timeout) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(timeout));
+    std::shared_ptr<wrench::WorkflowManager> created_wms;
+    {
+        std::unique_lock<std::mutex> lock(wms_mutex);
+        if (not wms_created.wait_until(lock, deadline, [this] { return this->wms != nullptr; })) {
+            return false;
+        }
+        created_wms = this->wms;
+    }
+    double remaining = std::chrono::duration<double>(deadline - std::chrono::steady_clock::now()).count();
+    if (not created_wms->waitUntilStarted(std::max(remaining, 0.0))) {
+        return false;
+    }
+
+    // The first caller to see the WMS started measures how long its first iteration took
+    if (not first_iteration_recorded.exchange(true)) {
+        std::unique_lock<std::mutex> lock(wms_mutex);
+        startup_phases.record("first iteration", launch_begin);
+    }
+    return true;
+}
+
+/**
+ * @brief Retrieves the durations of the phases of the creation and launch of the simulation
+ * recorded so far (the launch is only recorded once waitUntilReady() has returned true).
+ *
+ * @return const PhaseTimer& Phase durations.
+ */
+const PhaseTimer &SimulationThreadState::getStartupPhases() const {
+    return startup_phases;
+}
+
+/**
+ * @brief Retrieves the platform file for some cluster size, writing it the first time to a private
+ * temporary directory. Calling this function before forking sessions makes them share the file
+ * instead of each writing it. Not thread-safe.
+ *
+ * @param num_nodes Number of nodes to be simulated.
+ * @param num_cores Number of cores per node to be simulated.
+ * @return std::string Path of the file.
+ */
+std::string SimulationThreadState::getPlatformFile(int num_nodes, int num_cores) {
+    auto it = platform_files.find(std::make_pair(num_nodes, num_cores));
+    if (it != platform_files.end()) {
+        return it->second;
+    }
+
+    if (platform_dir.empty()) {
+        const char *tmp = getenv("TMPDIR");
+        std::string dir_template = std::string(tmp ? tmp : "/tmp") + "/slurm_simulator_XXXXXX";
+        if (mkdtemp(&dir_template[0]) == nullptr) {
+            std::cerr << "Cannot create a temporary directory for the platform file\n";
+            exit(1);
+        }
+        platform_dir = dir_template;
+    }
+
+    std::string path = platform_dir + "/platform_" + std::to_string(num_nodes) + "x" +
+                       std::to_string(num_cores) + ".xml";
+    write_xml(path, num_nodes, num_cores);
+    platform_files[std::make_pair(num_nodes, num_cores)] = path;
+    return path;
+}
+
+/**
+ * @brief Removes the platform files and their directory. Must only be called by the process that
+ * created them, once no session needs them anymore.
+ */
+void SimulationThreadState::removePlatformFiles() {
+    unlinkPlatformFiles();
+    platform_files.clear();
+    platform_dir.clear();
+}
+
+/**
+ * @brief Removes the platform files and their directory from the disk without touching the
+ * bookkeeping, so that it can be called from a signal handler (nothing is allocated nor freed).
+ * Must only be called by the process that created them.
+ */
+void SimulationThreadState::unlinkPlatformFiles() {
+    for (const auto &file : platform_files) {
+        unlink(file.second.c_str());
+    }
+    if (not platform_dir.empty()) {
+        rmdir(platform_dir.c_str());
+    }
+}
+
+/**
+ * @brief Makes the simulation wait, once created, for releaseLaunch() to be launched (e.g., so that a
+ * session can be prepared before it is needed). Must be called before createAndLaunchSimulation().
+ */
+void SimulationThreadState::holdLaunch() {
+    std::unique_lock<std::mutex> lock(wms_mutex);
+    launch_held = true;
+}
+
+/**
+ * @brief Lets a simulation held by holdLaunch() be launched.
+ */
+void SimulationThreadState::releaseLaunch() {
+    {
+        std::unique_lock<std::mutex> lock(wms_mutex);
+        launch_held = false;
+    }
+    launch_released.notify_all();
 }
 
 double SimulationThreadState::getSimulationTime() const {
     return this->wms->simulationTime;
 }
+
+unsigned long SimulationThreadState::getNumWakeups() const {
+    // The WMS may not have been created yet if the simulation thread is still starting up
+    if (not this->wms) {
+        return 0;
+    }
+    return this->wms->getNumWakeups();
+}
+
+std::map<std::string, std::tuple<size_t, size_t, unsigned long>> SimulationThreadState::getQueueDepths() const {
+    if (not this->wms) {
+        return {};
+    }
+    return this->wms->getQueueDepths();
+}
@@ -1,6 +1,10 @@
 #include "workflow_manager.h"
+#include "PhaseTimer.h"
 #include <unistd.h>
 
+#include <condition_variable>
+#include <mutex>
+
 
 class SimulationThreadState {
 public:
@@ -10,19 +14,79 @@ public:
 
     ~SimulationThreadState() {}
 
-    void getEventStatuses(std::queue<std::string>& statuses, const time_t& time) const;
+    unsigned long getEventStatuses(std::queue<wrench::JobEvent>& statuses) const;
+
+    unsigned long getEventStatuses(std::queue<wrench::JobEvent>& statuses, unsigned long after, bool& truncated) const;
+
+    unsigned long setServerTime(const double& time) const;
+
+    bool waitForAdvance(unsigned long sequence, double timeout) const;
+
+    bool waitForEvents(double timeout) const;
+
+    bool waitForEvents(unsigned long after, double timeout) const;
+
+    bool isStopping() const;
+
+    unsigned long advanceToNextJobEvent(double max_time) const;
+
+    bool hasPendingJobs() const;
 
     std::string addJob(const double& requested_duration,
                        const unsigned int& num_nodes, const double& actual_duration) const;
 
+    std::vector<std::string> addJobs(const std::vector<std::tuple<double, unsigned int, double>>& job_specs) const;
+
     bool cancelJob(const std::string& job_name) const;
 
     void stopSimulation() const;
 
-    std::vector<std::string> getQueue() const;
+    std::shared_ptr<const wrench::QueueSnapshot> getQueueSnapshot() const;
+
+    std::shared_ptr<const wrench::QueueSnapshot> findQueueSnapshot(unsigned long version) const;
+
+    bool waitUntilReady(double timeout);
+
+    const PhaseTimer &getStartupPhases() const;
+
+    static std::string getPlatformFile(int num_nodes, int num_cores);
+
+    static void removePlatformFiles();
+
+    static void unlinkPlatformFiles();
+
+    void holdLaunch();
+
+    void releaseLaunch();
 
     void createAndLaunchSimulation(int main_argc, char **main_argv, int num_nodes, int num_cores,
-                                          std::string tracefile_scheme);
+                                          std::string tracefile_scheme, bool event_driven_advance);
 
     double getSimulationTime() const;
+
+    unsigned long getNumWakeups() const;
+
+    std::map<std::string, std::tuple<size_t, size_t, unsigned long>> getQueueDepths() const;
+
+private:
+    std::mutex wms_mutex;
+    std::condition_variable wms_created;
+
+    /**
+     * @brief Whether the simulation, once created, should wait for releaseLaunch() to be launched.
+     */
+    bool launch_held = false;
+    std::condition_variable launch_released;
+
+    /**
+     * @brief Durations of the phases of the creation and launch of the simulation.
+     */
+    PhaseTimer startup_phases;
+
+    /**
+     * @brief Time at which the simulation was launched (protected by wms_mutex), and whether the
+     * first iteration of the WMS has been recorded since.
+     */
+    PhaseTimer::TimePoint launch_begin;
+    std::atomic<bool> first_iteration_recorded{false};
 };
@@ -0,0 +1,156 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace wrench {
+
+    /**
+     * @brief Bounded lock-free queue used to pass data between the web server and simulation threads.
+     *
+     * Each slot carries a sequence number that tells producers and consumers whether it is free or
+     * filled, so that pushes and pops only need a compare-and-swap on the shared position counters.
+     * Several threads may push or pop concurrently (httplib serves requests from a pool of threads).
+     * The capacity is rounded up to a power of two.
+     */
+    template <typename T>
+    class RingBuffer {
+
+    public:
+
+        explicit RingBuffer(size_t requested_capacity) : mask(roundUp(requested_capacity) - 1),
+                                                         cells(new Cell[mask + 1]) {
+            for (size_t i = 0; i <= mask; i++) {
+                cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        RingBuffer(const RingBuffer &) = delete;
+        RingBuffer &operator=(const RingBuffer &) = delete;
+
+        /**
+         * @brief Adds a value at the back of the queue.
+         *
+         * @param value Value to add.
+         * @return true on success, false if the queue is full (the caller decides how to apply backpressure).
+         */
+        bool push(T value) {
+            size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+            Cell *cell;
+            while (true) {
+                cell = &cells[pos & mask];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                auto diff = (std::ptrdiff_t) sequence - (std::ptrdiff_t) pos;
+                if (diff == 0) {
+                    if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    num_rejected.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                } else {
+                    pos = enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+            cell->data = std::move(value);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+
+            // Keep track of the deepest the queue has ever been
+            size_t depth = size();
+            size_t previous = high_water_mark.load(std::memory_order_relaxed);
+            while (depth > previous and
+                   not high_water_mark.compare_exchange_weak(previous, depth, std::memory_order_relaxed)) {}
+            return true;
+        }
+
+        /**
+         * @brief Removes the value at the front of the queue.
+         *
+         * @param value Where to move the removed value.
+         * @return true on success, false if the queue is empty.
+         */
+        bool pop(T &value) {
+            size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+            Cell *cell;
+            while (true) {
+                cell = &cells[pos & mask];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                auto diff = (std::ptrdiff_t) sequence - (std::ptrdiff_t) (pos + 1);
+                if (diff == 0) {
+                    if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = dequeue_pos.load(std::memory_order_relaxed);
+                }
+            }
+            value = std::move(cell->data);
+            cell->data = T();
+            cell->sequence.store(pos + mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool empty() const {
+            return size() == 0;
+        }
+
+        /**
+         * @brief Approximate number of values in the queue (exact when no push or pop is in progress).
+         */
+        size_t size() const {
+            size_t enqueued = enqueue_pos.load(std::memory_order_seq_cst);
+            size_t dequeued = dequeue_pos.load(std::memory_order_seq_cst);
+            if (dequeued >= enqueued) {
+                return 0;
+            }
+            return std::min(enqueued - dequeued, capacity());
+        }
+
+        size_t capacity() const {
+            return mask + 1;
+        }
+
+        size_t highWaterMark() const {
+            return high_water_mark.load(std::memory_order_relaxed);
+        }
+
+        unsigned long numRejected() const {
+            return num_rejected.load(std::memory_order_relaxed);
+        }
+
+    private:
+
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T data;
+        };
+
+        static size_t roundUp(size_t n) {
+            size_t capacity = 2;
+            while (capacity < n) {
+                capacity <<= 1;
+            }
+            return capacity;
+        }
+
+        const size_t mask;
+        std::unique_ptr<Cell[]> cells;
+
+        // Padding keeps the producer and consumer positions on different cache lines
+        char pad0[64];
+        std::atomic<size_t> enqueue_pos{0};
+        char pad1[64];
+        std::atomic<size_t> dequeue_pos{0};
+        char pad2[64];
+
+        std::atomic<size_t> high_water_mark{0};
+        std::atomic<unsigned long> num_rejected{0};
+    };
+}
+
+#endif // RING_BUFFER_H
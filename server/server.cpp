@@ -1,10 +1,21 @@
 #include "httplib.h"
 #include "SimulationThreadState.h"
+#include "SimulationClock.h"
+#include "AsyncLogger.h"
+#include "AssetCache.h"
+#include "AdmissionControl.h"
+#include "PhaseTimer.h"
+#include "Journal.h"
 
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <thread>
@@ -14,14 +25,35 @@
 #include <nlohmann/json.hpp>
 #include <wrench.h>
 
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/types.h>
+#include <netinet/in.h>
 #include <sys/wait.h>
 
 #include <signal.h>
+#include <time.h>
 
 #define SIMULATION_RESET 100
 #define SIMULATION_END 101
-bool simulation_reset = false;
+// Maximum number of seconds to wait for the simulation to catch up after a time skip
+#define ADVANCE_TIMEOUT 30
+// Maximum number of milliseconds a long-polling /api/query request may wait for events
+#define QUERY_MAX_WAIT 30000
+// Number of milliseconds between two time updates on the /api/events stream
+#define EVENT_STREAM_TICK 1000
+// Default maximum number of simulated seconds to skip when advancing to the next job event
+#define NEXT_EVENT_MAX_INCREMENT (100 * 24 * 3600)
+// Number of seconds after which clients should retry requests shed because the server is busy
+#define RETRY_AFTER 1
+// Range of speeds of the server simulated time, in simulated seconds per wall-clock second
+#define MIN_SPEED 0.001
+#define MAX_SPEED 1000000.0
+// Number of milliseconds between two checks of whether a session has stopped accepting connections
+#define LISTENER_POLL_INTERVAL 100
+// Suffix of the path to which a journal whose replay made the server crash is moved
+#define JOURNAL_FAILED_SUFFIX ".failed"
+std::atomic<bool> simulation_reset(false);
 
 void signal_handler(int sig) {
     if (sig == SIGSEGV) {
@@ -29,10 +61,31 @@ void signal_handler(int sig) {
     }
 }
 
+/**
+ * @brief Signals that stop the server, on which the temporary platform files have to be removed.
+ */
+const int TERMINATION_SIGNALS[] = {SIGINT, SIGTERM, SIGHUP};
+
+/**
+ * @brief Handler of the termination signals in the process that wrote the platform files, which
+ * removes them before letting the signal terminate the process as it would have.
+ */
+void termination_signal_handler(int sig) {
+    SimulationThreadState::unlinkPlatformFiles();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
 
+/**
+ * @brief Sets the handler of all the termination signals.
+ * @param handler Handler (e.g., SIG_DFL)
+ */
+void setTerminationHandler(void (*handler)(int)) {
+    for (int sig : TERMINATION_SIGNALS) {
+        signal(sig, handler);
+    }
+}
 
-// Define a long function which is used multiple times to retrieve the time
-#define get_time() (std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count())
 
 using httplib::Request;
 using httplib::Response;
@@ -40,18 +93,70 @@ using json = nlohmann::json;
 
 namespace po = boost::program_options;
 
-httplib::Server server;
+AdmissionServer server;
 
 /**
- * @brief Time offset used to calculate simulation time.
- * 
- * The time in milliseconds used to subtract from the current time to get the simulated time which starts at 0.
+ * @brief Server simulated time, which starts at 0 and runs at a configurable speed.
+ */
+SimulationClock simulation_clock;
+
+/**
+ * @brief Client files, loaded once by the parent process and shared by all sessions.
+ */
+AssetCache asset_cache;
+
+/**
+ * @brief Identifies this session in the ETags of its responses, so that a tag obtained from a
+ * previous session (before a reset) never matches.
  */
-time_t time_start = 0;
+std::string session_tag;
 
 std::thread simulation_thread;
 SimulationThreadState *simulation_thread_state;
 
+/**
+ * @brief Listening socket, bound once by the parent process and shared by all sessions, so that
+ * connections made while a session resets wait for the next session instead of being refused.
+ */
+int listener = -1;
+
+/**
+ * @brief Descriptor through which the web server of this session accepts connections from listener.
+ */
+int server_socket = -1;
+
+/**
+ * @brief Monotonic wall-clock time in milliseconds of the latest reset request, shared with the
+ * parent process so that the next session can report how long the reset took (0 if none).
+ */
+std::atomic<long long> *reset_request_time = nullptr;
+
+/**
+ * @brief Durations of the phases of the startup of the server (recorded once by the parent process)
+ * and of this session, and how long the reset that started this session took (negative if none).
+ */
+PhaseTimer startup_phases;
+std::atomic<double> reset_duration(-1);
+
+/**
+ * @brief Journal of the actions of this session, replayed by the next session if this one crashes.
+ */
+Journal journal;
+
+/**
+ * @brief Serializes job submissions with their journal entries, so that a replay names jobs as
+ * they were named when submitted.
+ */
+std::mutex submission_mutex;
+
+/**
+ * @brief Limits on the requests that can hold a web server thread for a long time: those waiting
+ * for the simulation to catch up, and event streams and long polls. The remaining threads are
+ * always available for cheap requests.
+ */
+RequestLimiter slow_requests;
+RequestLimiter stream_requests;
+
 /**
  * Ugly globals
  */
@@ -63,7 +168,163 @@ int pp_parwork;
 int num_cluster_nodes;
 int num_cores_per_node;
 std::string tracefile_scheme;
+std::string advance_mode;
+int cpu_report_interval;
+int idle_pause_timeout;
+int http_threads;
+int http_queue;
+int port_number;
+std::string headless_script;
+std::string report_path;
+std::string journal_path;
+unsigned int rng_seed;
+
+/**
+ * @brief Monotonic wall-clock time in milliseconds of the last request, and whether the clock was
+ * paused because there was no request in a while (as opposed to paused by the user).
+ */
+std::atomic<time_t> last_request_time(0);
+std::atomic<bool> idle_paused(false);
+
+/**
+ * @brief Records client activity (a request, or an event stream still being watched), and resumes
+ * the server simulated time if it was paused for lack of activity (see pauseWhenIdle()).
+ */
+void recordActivity()
+{
+    last_request_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (idle_paused.exchange(false)) {
+        simulation_clock.resume();
+    }
+}
+
+
+// ADMISSION CONTROL
+
+/**
+ * @brief Rejects a request because the server is too busy, asking the client to retry later. Only
+ * such responses have a Retry-After header, which tells clients that the request was not carried out
+ * and can safely be sent again.
+ *
+ * @param res HTTP response object
+ */
+void shed(Response& res)
+{
+    json body;
+    body["error"] = "Server busy, retry later";
+    res.status = 503;
+    res.set_header("access-control-allow-origin", "*");
+    res.set_header("Access-Control-Expose-Headers", "Retry-After");
+    res.set_header("Retry-After", std::to_string(RETRY_AFTER));
+    res.set_content(body.dump(), "application/json");
+}
+
+/**
+ * @brief Wraps the handler of requests that wait for the simulation, so that they are shed when
+ * too many of them are in progress.
+ *
+ * @param handler Request handler
+ * @return httplib::Server::Handler Wrapped handler
+ */
+httplib::Server::Handler admitSlow(httplib::Server::Handler handler)
+{
+    return [handler](const Request& req, Response& res) {
+        RequestLimiter::Slot slot;
+        if (!(slot = slow_requests.tryAcquire()))
+        {
+            SERVER_LOG(Request, Info, "Shedding %s", req.path.c_str());
+            shed(res);
+            return;
+        }
+        handler(req, res);
+    };
+}
+
+/**
+ * @brief Takes a slot for an event stream or a long poll, unless too many are in progress.
+ *
+ * @param req HTTP request object
+ * @return RequestLimiter::Slot The slot, to hold until the response is over, or nullptr if the
+ * request should be shed.
+ */
+RequestLimiter::Slot admitStream(const Request& req)
+{
+    RequestLimiter::Slot slot;
+    if (!(slot = stream_requests.tryAcquire()))
+    {
+        SERVER_LOG(Request, Info, "Shedding %s", req.path.c_str());
+        return nullptr;
+    }
+    return slot;
+}
+
+// SESSIONS
+
+/**
+ * @brief Creates the listening socket shared by all sessions.
+ *
+ * @param port Server port
+ * @return int Socket descriptor, or -1 on failure.
+ */
+int bindListener(int port)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0)
+        return -1;
+
+    int yes = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(sock, (struct sockaddr *) &address, sizeof(address)) < 0 || listen(sock, SOMAXCONN) < 0)
+    {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+/**
+ * @brief Makes the web server accept connections from the shared listening socket. httplib can
+ * only listen on a socket it created, hence it binds a throwaway socket whose descriptor is then
+ * replaced with the shared socket.
+ *
+ * @return true on success, false otherwise.
+ */
+bool acceptFromListener()
+{
+    server.set_socket_options([](socket_t sock) { server_socket = sock; });
+    if (server.bind_to_any_port("127.0.0.1") < 0 || dup2(listener, server_socket) < 0)
+        return false;
+
+    // Check regularly whether the session has stopped listening (see beginReset())
+    server.set_idle_interval(0, LISTENER_POLL_INTERVAL * 1000);
+    return true;
+}
+
+/**
+ * @brief Makes this session stop accepting connections and records when the reset was requested.
+ * Server::stop() would shut the shared socket down for the next sessions too, hence the web server
+ * descriptor is replaced with an unconnected socket instead, on which accepting fails. Connections
+ * made from now on wait for the next session, which is started once the current request has been
+ * answered (see afterRequest()).
+ */
+void beginReset()
+{
+    int placeholder = socket(AF_INET, SOCK_STREAM, 0);
+    dup2(placeholder, server_socket);
+    close(placeholder);
 
+    *reset_request_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    // The user wants a new simulation, not this one back
+    journal.clear();
+}
 
 // GET PATHS
 
@@ -75,67 +336,433 @@ std::string tracefile_scheme;
  */
 void getTime(const Request& req, Response& res)
 {
-    std::printf("Path: %s\n\n", req.path.c_str());
+    SERVER_LOG(Poll, Info, "%s", req.path.c_str());
 
     json body;
 
     // Checks if time has started otherwise return an error.
-    if (time_start == 0)
+    if (!simulation_clock.isStarted())
     {
         res.status = 400;
         return;
     }
 
     // Sets and returns the time.
-    body["time"] = get_time() - time_start;
+    body["time"] = simulation_clock.now();
     res.set_header("access-control-allow-origin", "*");
     res.set_content(body.dump(), "application/json");
 }
 
 /**
- * @brief Path handling the retrieval of even statuses.
- * 
+ * @brief Converts the phases recorded by a timer to JSON.
+ *
+ * @param timer Phase timer
+ * @return json Total duration, phase durations, and idle phase durations (not in the total) in milliseconds
+ */
+json phasesToJson(const PhaseTimer& timer)
+{
+    json phases = json::array();
+    for (const auto &phase : timer.getPhases())
+    {
+        json entry;
+        entry["phase"] = phase.first;
+        entry["ms"] = phase.second;
+        phases.push_back(entry);
+    }
+    json waits = json::array();
+    for (const auto &wait : timer.getWaits())
+    {
+        json entry;
+        entry["phase"] = wait.first;
+        entry["ms"] = wait.second;
+        waits.push_back(entry);
+    }
+    json body;
+    body["total"] = timer.getTotal();
+    body["phases"] = phases;
+    body["waits"] = waits;
+    return body;
+}
+
+/**
+ * @brief Path handling diagnostics: how long each phase of the startup of the server, of this
+ * session, and of the creation and launch of its simulation took, and how long the reset that
+ * started this session took, so that startup regressions can be tracked.
+ *
  * @param req HTTP request object
  * @param res HTTP response object
  */
-void getQuery(const Request& req, Response& res)
+void getDiagnostics(const Request& req, Response& res)
+{
+    SERVER_LOG(Request, Info, "%s", req.path.c_str());
+
+    json body;
+    body["session"] = session_tag;
+    body["startup"] = phasesToJson(startup_phases);
+    body["simulation"] = phasesToJson(simulation_thread_state->getStartupPhases());
+    if (reset_duration >= 0)
+        body["reset"] = reset_duration.load();
+    res.set_header("access-control-allow-origin", "*");
+    res.set_content(body.dump(), "application/json");
+}
+
+/**
+ * @brief Reads the event cursor of a request, i.e., the sequence number of the latest event the
+ * client already has, from the Last-Event-ID header of reconnecting event streams or else from
+ * the "after" parameter.
+ *
+ * @param req HTTP request object
+ * @param cursor Where to store the cursor
+ * @return true if the request has a cursor, false otherwise
+ */
+bool getEventCursor(const Request& req, unsigned long& cursor)
+{
+    // A reconnecting browser sends the same URL, so the header is more recent than the parameter
+    std::string value;
+    if (req.has_header("Last-Event-ID"))
+        value = req.get_header_value("Last-Event-ID");
+    else if (req.has_param("after"))
+        value = req.get_param_value("after");
+    else
+        return false;
+    cursor = std::strtoul(value.c_str(), nullptr, 10);
+    return true;
+}
+
+/**
+ * @brief Converts a job event into the JSON object returned to clients.
+ *
+ * @param event Job event
+ * @return json {"seq", "time", "type" ("completed" or "failed"), "job", "submit", "start", "end"}
+ */
+json jobEventToJson(const wrench::JobEvent& event)
+{
+    json record;
+    record["seq"] = event.sequence;
+    record["time"] = event.time;
+    record["type"] = (event.type == wrench::JobEvent::COMPLETED ? "completed" : "failed");
+    record["job"] = event.job_name;
+    record["submit"] = event.submit_date;
+    record["start"] = event.start_date;
+    record["end"] = event.end_date;
+    return record;
+}
+
+/**
+ * @brief Appends a value to a binary message, in host byte order.
+ */
+template <typename T>
+void appendBinary(std::string& message, const T& value)
+{
+    message.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/**
+ * @brief Appends a job event to a binary message (see getQuery() for the layout).
+ *
+ * @param message Binary message
+ * @param event Job event
+ */
+void appendBinaryEvent(std::string& message, const wrench::JobEvent& event)
+{
+    appendBinary<uint64_t>(message, event.sequence);
+    appendBinary<double>(message, event.time);
+    appendBinary<uint8_t>(message, event.type);
+    appendBinary<double>(message, event.submit_date);
+    appendBinary<double>(message, event.start_date);
+    appendBinary<double>(message, event.end_date);
+    appendBinary<uint16_t>(message, (uint16_t)event.job_name.size());
+    message += event.job_name;
+}
+
+/**
+ * @brief Retrieves the job events to return to a client: those after the client cursor if the
+ * request has one (which does not consume them), or else those not yet returned to any request
+ * without a cursor.
+ *
+ * @param req HTTP request object
+ * @param status Queue to hold the job events
+ * @param truncated Set to true if the client cursor could not be honored exactly
+ * @return unsigned long Cursor to pass with the next request
+ */
+unsigned long retrieveEvents(const Request& req, std::queue<wrench::JobEvent>& status, bool& truncated)
 {
-    // Create queue to hold event statuses
-    std::queue<std::string> status;
-    std::vector<std::string> events;
+    unsigned long cursor;
+    truncated = false;
+    if (getEventCursor(req, cursor))
+        return simulation_thread_state->getEventStatuses(status, cursor, truncated);
+    return simulation_thread_state->getEventStatuses(status);
+}
 
-    // Retrieves event statuses from servers and
-    simulation_thread_state->getEventStatuses(status, (get_time() - time_start) / 1000);
+/**
+ * @brief Retrieves the job events to return to a client (see above) into a JSON response body,
+ * along with the cursor to pass with the next request.
+ *
+ * @param req HTTP request object
+ * @param body Response body
+ */
+void retrieveEvents(const Request& req, json& body)
+{
+    std::queue<wrench::JobEvent> status;
+    bool truncated;
+    body["cursor"] = retrieveEvents(req, status, truncated);
+    if (truncated)
+        body["truncated"] = true;
 
+    json events = json::array();
     while(!status.empty())
     {
-        events.push_back(status.front());
+        events.push_back(jobEventToJson(status.front()));
         status.pop();
     }
+    body["events"] = events;
+}
+
+/**
+ * @brief Path handling the retrieval of even statuses. With a "wait" parameter (in milliseconds),
+ * the request blocks until some event is available or the wait time expires (long polling), unless
+ * too many requests are already waiting, in which case it is shed with a 503 (see admitStream()). With
+ * an "after" parameter, only the events after that cursor are returned (see retrieveEvents()).
+ *
+ * With a "format=binary" parameter, the response is a compact binary message rather than JSON,
+ * with all values in host byte order (little-endian on supported platforms) and no padding:
+ *   - header: int64 time (ms), double speed, uint64 cursor, uint8 truncated, uint32 number of events
+ *   - each event: uint64 sequence, double time, uint8 type (0 completed, 1 failed), double submit,
+ *     double start, double end, uint16 job name length, job name bytes
+ * 
+ * @param req HTTP request object
+ * @param res HTTP response object
+ */
+void getQuery(const Request& req, Response& res)
+{
+    // Wait for events if asked to
+    if (req.has_param("wait"))
+    {
+        auto slot = admitStream(req);
+        if (!slot)
+        {
+            shed(res);
+            return;
+        }
+        long wait = std::min(std::max(std::atol(req.get_param_value("wait").c_str()), 0L), (long)QUERY_MAX_WAIT);
+        unsigned long cursor;
+        if (getEventCursor(req, cursor))
+            simulation_thread_state->waitForEvents(cursor, (double)wait / 1000.0);
+        else
+            simulation_thread_state->waitForEvents((double)wait / 1000.0);
+    }
+
+    // Retrieves event statuses from servers (the simulation is kept up to date with the server
+    // time by the clock driver, see driveSimulation())
+    if (req.has_param("format") && req.get_param_value("format") == "binary")
+    {
+        std::queue<wrench::JobEvent> status;
+        bool truncated;
+        unsigned long cursor = retrieveEvents(req, status, truncated);
+
+        std::string message;
+        appendBinary<int64_t>(message, simulation_clock.now());
+        appendBinary<double>(message, simulation_clock.getSpeed());
+        appendBinary<uint64_t>(message, cursor);
+        appendBinary<uint8_t>(message, truncated);
+        appendBinary<uint32_t>(message, (uint32_t)status.size());
+        while (!status.empty())
+        {
+            appendBinaryEvent(message, status.front());
+            status.pop();
+        }
+        res.set_header("Access-Control-Allow-Origin", "*");
+        res.set_content(message, "application/octet-stream");
+        return;
+    }
 
     json body;
-    auto event_list = events;
-    body["time"] = get_time() - time_start;
-    body["events"] = event_list;
+    body["time"] = simulation_clock.now();
+    body["speed"] = simulation_clock.getSpeed();
+    retrieveEvents(req, body);
     res.set_header("Access-Control-Allow-Origin", "*");
     res.set_content(body.dump(), "application/json");
 }
 
 /**
- * @brief Path handling the current jobs in the queue running or waiting.
+ * @brief Path handling the stream of server-sent events: a "job" event with the same job record
+ * as returned by /api/query as soon as a job completes or fails, and a "time" event with
+ * the current server simulated time every EVENT_STREAM_TICK milliseconds. Events carry their
+ * sequence number as id, so that a reconnecting browser resumes the stream where it left off
+ * (Last-Event-ID), and a "truncated" event precedes them if the stream could not resume exactly
+ * (see WorkflowManager::getEventStatuses()). A new stream starts with all the retained events
+ * unless given an "after" parameter.
+ *
+ * Note that the stream keeps one web server thread busy for as long as the client is connected,
+ * hence the number of streams (and long polls) is limited (see admitStream()).
+ *
+ * @param req HTTP request object
+ * @param res HTTP response object
+ */
+void getEvents(const Request& req, Response& res)
+{
+    SERVER_LOG(Poll, Info, "%s", req.path.c_str());
+
+    // The slot is held by the content provider, i.e., for as long as the stream lasts
+    auto slot = admitStream(req);
+    if (!slot)
+    {
+        shed(res);
+        return;
+    }
+
+    auto cursor = std::make_shared<unsigned long>(0);
+    getEventCursor(req, *cursor);
+
+    res.set_header("access-control-allow-origin", "*");
+    res.set_header("Cache-Control", "no-cache");
+    res.set_chunked_content_provider("text/event-stream", [cursor, slot](size_t offset, httplib::DataSink &sink) {
+        // Wait for events, or until it is time to send the time
+        simulation_thread_state->waitForEvents(*cursor, (double)EVENT_STREAM_TICK / 1000.0);
+
+        // End the stream if the simulation is going away
+        if (simulation_thread_state->isStopping())
+        {
+            sink.done();
+            return true;
+        }
+
+        std::queue<wrench::JobEvent> status;
+        bool truncated;
+        *cursor = simulation_thread_state->getEventStatuses(status, *cursor, truncated);
+
+        std::string message;
+        if (truncated)
+        {
+            json truncation;
+            truncation["cursor"] = *cursor;
+            message += "event: truncated\ndata: " + truncation.dump() + "\n\n";
+        }
+        while (!status.empty())
+        {
+            message += "event: job\nid: " + std::to_string(status.front().sequence) + "\ndata: " +
+                       jobEventToJson(status.front()).dump() + "\n\n";
+            status.pop();
+        }
+        json time;
+        time["time"] = simulation_clock.now();
+        time["speed"] = simulation_clock.getSpeed();
+        message += "event: time\nid: " + std::to_string(*cursor) + "\ndata: " + time.dump() + "\n\n";
+
+        sink.write(message.data(), message.size());
+
+        // Requests are only recorded once answered, hence a stream still being watched is activity
+        if (idle_pause_timeout > 0 && sink.is_writable())
+        {
+            recordActivity();
+        }
+        return sink.is_writable();
+    });
+}
+
+/**
+ * @brief Converts a queue entry into the JSON object returned to clients.
+ *
+ * @param entry Queue entry
+ * @return json {"user", "job", "nodes", "requested", "start"} (start is negative for pending jobs)
+ */
+json queueEntryToJson(const wrench::QueueEntry& entry)
+{
+    json record;
+    record["user"] = entry.user;
+    record["job"] = entry.job_name;
+    record["nodes"] = entry.num_nodes;
+    record["requested"] = entry.requested_duration;
+    record["start"] = entry.start_date;
+    return record;
+}
+
+/**
+ * @brief Path handling the current jobs in the queue running or waiting. The response carries
+ * the queue version as ETag, and is a 304 without body if the If-None-Match header matches it.
+ *
+ * By default, the queue is a list of comma-separated "user,job,nodes,requested,start" strings.
+ * With a "since" parameter (a "version" value from an earlier response), the response only holds
+ * what changed since that version, as {"version", "full", "jobs", "removed"}: "jobs" are the
+ * records of the jobs added or changed (see queueEntryToJson()) and "removed" the names of the
+ * jobs no longer in the queue. If that version is no longer known (e.g., "since=0"), "full" is
+ * true and "jobs" holds the whole queue.
  * 
  * @param req HTTP request object
  * @param res HTTP response object
  */
 void getQueue(const Request& req, Response& res)
 {
-    std::printf("Path: %s\n\n", req.path.c_str());
+    SERVER_LOG(Poll, Info, "%s", req.path.c_str());
 
-    json body;
-    body["time"] = get_time() - time_start;
-    body["queue"] = simulation_thread_state->getQueue();
+    auto snapshot = simulation_thread_state->getQueueSnapshot();
+    std::string version = session_tag + "-" + std::to_string(snapshot->version);
 
+    // Nothing to send if the client already has this version of the queue
+    std::string etag = "\"" + version + "\"";
     res.set_header("access-control-allow-origin", "*");
+    res.set_header("Access-Control-Expose-Headers", "ETag");
+    res.set_header("ETag", etag);
+    if (req.get_header_value("If-None-Match") == etag)
+    {
+        res.status = 304;
+        return;
+    }
+
+    json body;
+    body["time"] = simulation_clock.now();
+
+    if (!req.has_param("since"))
+    {
+        // Front-end will handle parsing of information so information is passed as a comma-separated string.
+        std::vector<std::string> queue;
+        for (const auto &entry : snapshot->jobs)
+        {
+            queue.push_back(entry.user + ',' + entry.job_name + ',' + std::to_string(entry.num_nodes) + ',' +
+                            std::to_string(entry.requested_duration) + ',' + std::to_string(entry.start_date));
+        }
+        body["queue"] = queue;
+        res.set_content(body.dump(), "application/json");
+        return;
+    }
+
+    // Versions from another session are unknown
+    std::shared_ptr<const wrench::QueueSnapshot> previous;
+    std::string since = req.get_param_value("since");
+    if (since.compare(0, session_tag.size() + 1, session_tag + "-") == 0)
+    {
+        previous = simulation_thread_state->findQueueSnapshot(
+                std::strtoul(since.c_str() + session_tag.size() + 1, nullptr, 10));
+    }
+
+    json jobs = json::array();
+    json removed = json::array();
+    if (!previous)
+    {
+        for (const auto &entry : snapshot->jobs)
+            jobs.push_back(queueEntryToJson(entry));
+    }
+    else if (previous != snapshot)
+    {
+        std::map<std::string, const wrench::QueueEntry *> previous_jobs;
+        for (const auto &entry : previous->jobs)
+            previous_jobs[entry.job_name] = &entry;
+        for (const auto &entry : snapshot->jobs)
+        {
+            auto it = previous_jobs.find(entry.job_name);
+            if (it == previous_jobs.end() || !(*it->second == entry))
+                jobs.push_back(queueEntryToJson(entry));
+            if (it != previous_jobs.end())
+                previous_jobs.erase(it);
+        }
+        for (const auto &entry : previous_jobs)
+            removed.push_back(entry.first);
+    }
+
+    body["version"] = version;
+    body["full"] = !previous;
+    body["jobs"] = jobs;
+    body["removed"] = removed;
     res.set_content(body.dump(), "application/json");
 }
 
@@ -149,9 +776,12 @@ void getQueue(const Request& req, Response& res)
  */
 void start(const Request& req, Response& res)
 {
-    std::printf("Path: %s\nBody: %s\n\n", req.path.c_str(), req.body.c_str());
+    SERVER_LOG(Request, Info, "%s %s", req.path.c_str(), req.body.c_str());
 
-    time_start = get_time();
+    // Will restart! like in a reset, in case this is a page reload
+    beginReset();
+
+    simulation_clock.start();
     res.set_header("access-control-allow-origin", "*");
 
 
@@ -168,11 +798,10 @@ void start(const Request& req, Response& res)
     body["pp_seqwork"] = pp_seqwork;
     body["pp_parwork"] = pp_parwork;
     body["num_cluster_nodes"] = num_cluster_nodes;
-    body["num_seconds_to_sleep_before_anything"] = 5;
+    body["num_seconds_to_sleep_before_anything"] = 0;
     res.set_header("access-control-allow-origin", "*");
+    res.set_header("Connection", "close");
     res.set_content(body.dump(), "application/json");
-
-    server.stop(); // will restart! like in a reset, in case this is a page reload
 }
 
 /**
@@ -183,7 +812,7 @@ void start(const Request& req, Response& res)
  */
 void stop(const Request& req, Response& res)
 {
-    std::printf("Path: %s\nBody: %s\n\n", req.path.c_str(), req.body.c_str());
+    SERVER_LOG(Request, Info, "%s %s", req.path.c_str(), req.body.c_str());
 
     // Stop the server
     simulation_thread_state->stopSimulation();
@@ -191,6 +820,7 @@ void stop(const Request& req, Response& res)
     // Join with the thread
     simulation_thread.join();
     // Erase the simulated state
+    journal.clear();
     res.set_header("access-control-allow-origin", "*");
     std::exit(0);
 }
@@ -203,7 +833,9 @@ void stop(const Request& req, Response& res)
  */
 void reset(const Request& req, Response& res)
 {
-    std::printf("Path: %s\nBody: %s\n\n", req.path.c_str(), req.body.c_str());
+    SERVER_LOG(Request, Info, "%s %s", req.path.c_str(), req.body.c_str());
+
+    beginReset();
 
     // Stop simulation
     simulation_thread_state->stopSimulation();
@@ -213,7 +845,7 @@ void reset(const Request& req, Response& res)
     simulation_reset = true;
 
     res.set_header("access-control-allow-origin", "*");
-    server.stop();
+    res.set_header("Connection", "close");
 }
 
 /**
@@ -224,96 +856,483 @@ void reset(const Request& req, Response& res)
  */
 void addTime(const Request& req, Response& res)
 {
-    std::printf("Path: %s\nBody: %s\n\n", req.path.c_str(), req.body.c_str());
-    std::queue<std::string> status;
-    std::vector<std::string> events;
+    SERVER_LOG(Request, Info, "%s %s", req.path.c_str(), req.body.c_str());
 
     json req_body = json::parse(req.body);
 
-    time_start -= req_body["increment"].get<int>() * 1000;
-
-    // Retrieve the event statuses during the  skip period.
-    simulation_thread_state->getEventStatuses(status, (get_time() - time_start) / 1000);
-    cerr << "status.size() = " << status.size()  << "\n";
-
-    while(!status.empty())
+    // Refuse increments that would move the clock backward or overflow it
+    auto increment = req_body["increment"].get<long long>();
+    if (increment < 0 || increment > (std::numeric_limits<time_t>::max() - simulation_clock.now()) / 1000)
     {
-        events.push_back(status.front());
-        status.pop();
+        res.status = 400;
+        json body;
+        body["error"] = "Invalid increment";
+        body["time"] = simulation_clock.now();
+        res.set_header("access-control-allow-origin", "*");
+        res.set_content(body.dump(), "application/json");
+        return;
     }
 
-    // Let the simulation catch up
-    while ((get_time() - time_start) / 1000 > simulation_thread_state->getSimulationTime()) {
-        usleep(1000);
-    }
+    // Journal the skip from where the simulation is to where it is asked to go, which is what a
+    // replay has to do
+    double before = simulation_thread_state->getSimulationTime();
+    simulation_clock.advance((time_t)increment * 1000);
+    time_t target = simulation_clock.now() / 1000;
+    journal.recordSkip(before, std::max((double)target - before, 0.0));
 
+    // Let the simulation catch up with the skip period.
+    auto advance = simulation_thread_state->setServerTime(target);
+    bool caught_up = simulation_thread_state->waitForAdvance(advance, ADVANCE_TIMEOUT);
+
+    // Retrieve the event statuses, including those that occurred during the skip period
     json body;
-    auto event_list = events;
-    body["time"] = get_time() - time_start;
-    body["events"] = event_list;
+    body["time"] = simulation_clock.now();
+    retrieveEvents(req, body);
+    SERVER_LOG(Request, Debug, "%zu events returned after the time skip", body["events"].size());
+    if (!caught_up)
+    {
+        res.status = 503;
+        body["error"] = "Simulation did not catch up within " + std::to_string(ADVANCE_TIMEOUT) + " seconds";
+    }
     res.set_header("access-control-allow-origin", "*");
     res.set_content(body.dump(), "application/json");
 }
 
 
 /**
- * @brief Path handling adding a job to the simulated batch scheduler.
- * 
+ * @brief Path handling changing the speed of the server simulated time, i.e., the number of
+ * simulated seconds per wall-clock second.
+ *
  * @param req HTTP request object
  * @param res HTTP response object
  */
-void addJob(const Request& req, Response& res)
+void setSpeed(const Request& req, Response& res)
 {
+    SERVER_LOG(Request, Info, "%s %s", req.path.c_str(), req.body.c_str());
+
     json req_body = json::parse(req.body);
-    std::printf("Path: %s\nBody: %s\n\n", req.path.c_str(), req.body.c_str());
+    auto speed = req_body["speed"].get<double>();
 
-    // Retrieve task creation info from request body
-    auto requested_duration = req_body["job"]["durationInSec"].get<double>();
-    auto num_nodes = req_body["job"]["numNodes"].get<int>();
-    double actual_duration = (double)pp_seqwork + ((double)pp_parwork / num_nodes);
     json body;
-
-    // Pass parameters in to function to add a job.
-    std::string jobID = simulation_thread_state->addJob(requested_duration, num_nodes, actual_duration);
-
-    // Retrieve the return value from adding ajob to determine if successful.
-    if(!jobID.empty())
+    if (std::isfinite(speed) && speed >= MIN_SPEED && speed <= MAX_SPEED)
     {
-        body["time"] = get_time() - time_start;
-        body["jobID"] = jobID;
+        simulation_clock.setSpeed(speed);
         body["success"] = true;
     }
     else
     {
-        body["time"] = get_time() - time_start;
+        res.status = 400;
         body["success"] = false;
     }
-
+    body["time"] = simulation_clock.now();
+    body["speed"] = simulation_clock.getSpeed();
     res.set_header("access-control-allow-origin", "*");
     res.set_content(body.dump(), "application/json");
 }
 
 /**
- * @brief Path handling canceling a job from the simulated batch scheduler.
- * 
+ * @brief Path handling pausing the server simulated time.
+ *
+ * @param req HTTP request object
+ * @param res HTTP response object
+ */
+void pauseTime(const Request& req, Response& res)
+{
+    SERVER_LOG(Request, Info, "%s %s", req.path.c_str(), req.body.c_str());
+
+    simulation_clock.pause();
+
+    json body;
+    body["time"] = simulation_clock.now();
+    res.set_header("access-control-allow-origin", "*");
+    res.set_content(body.dump(), "application/json");
+}
+
+/**
+ * @brief Path handling resuming the server simulated time after a pause.
+ *
+ * @param req HTTP request object
+ * @param res HTTP response object
+ */
+void resumeTime(const Request& req, Response& res)
+{
+    SERVER_LOG(Request, Info, "%s %s", req.path.c_str(), req.body.c_str());
+
+    simulation_clock.resume();
+
+    json body;
+    body["time"] = simulation_clock.now();
+    res.set_header("access-control-allow-origin", "*");
+    res.set_content(body.dump(), "application/json");
+}
+
+/**
+ * @brief Path handling advancing the server simulated time until the next completion or failure
+ * of a user job, or by at most an optional number of seconds ("maxIncrement").
+ *
+ * @param req HTTP request object
+ * @param res HTTP response object
+ */
+void nextEvent(const Request& req, Response& res)
+{
+    SERVER_LOG(Request, Info, "%s %s", req.path.c_str(), req.body.c_str());
+
+    double max_increment = NEXT_EVENT_MAX_INCREMENT;
+    if (!req.body.empty())
+    {
+        json req_body = json::parse(req.body);
+        if (req_body.count("maxIncrement"))
+            max_increment = req_body["maxIncrement"].get<double>();
+    }
+
+    // Refuse caps that would not move the clock forward or would overflow it
+    if (!std::isfinite(max_increment) || max_increment <= 0 ||
+        max_increment > (double)((std::numeric_limits<time_t>::max() - simulation_clock.now()) / 1000))
+    {
+        res.status = 400;
+        json body;
+        body["error"] = "Invalid maxIncrement";
+        body["time"] = simulation_clock.now();
+        res.set_header("access-control-allow-origin", "*");
+        res.set_content(body.dump(), "application/json");
+        return;
+    }
+
+    // Nothing to wait for if no user job is pending
+    bool caught_up = true;
+    if (simulation_thread_state->hasPendingJobs())
+    {
+        double before = simulation_thread_state->getSimulationTime();
+        double now = (double)(simulation_clock.now() / 1000);
+        auto advance = simulation_thread_state->advanceToNextJobEvent(now + max_increment);
+
+        // Let the simulation run until the event (or the cap)
+        caught_up = simulation_thread_state->waitForAdvance(advance, ADVANCE_TIMEOUT);
+
+        // Move the server time forward to wherever the simulation stopped, and journal the skip to
+        // that exact simulated time
+        double stop = simulation_thread_state->getSimulationTime();
+        simulation_clock.advanceTo((time_t)(stop * 1000));
+        journal.recordSkip(before, stop - before);
+    }
+
+    // Retrieve the event statuses, including the one the simulation stopped at.
+    json body;
+    body["time"] = simulation_clock.now();
+    retrieveEvents(req, body);
+    if (!caught_up)
+    {
+        res.status = 503;
+        body["error"] = "Simulation did not catch up within " + std::to_string(ADVANCE_TIMEOUT) + " seconds";
+    }
+    res.set_header("access-control-allow-origin", "*");
+    res.set_content(body.dump(), "application/json");
+}
+
+/**
+ * @brief Checks the arguments of a job submission, so that invalid jobs are neither added nor
+ * journaled (the replay of the journal would fail on them).
+ *
+ * @param num_nodes Number of nodes requested.
+ * @param requested_duration Requested duration in seconds.
+ * @return true if valid.
+ */
+bool isValidJob(int num_nodes, double requested_duration)
+{
+    return num_nodes >= 1 && std::isfinite(requested_duration) && requested_duration > 0;
+}
+
+/**
+ * @brief Path handling adding a job to the simulated batch scheduler.
+ * 
+ * @param req HTTP request object
+ * @param res HTTP response object
+ */
+void addJob(const Request& req, Response& res)
+{
+    json req_body = json::parse(req.body);
+    SERVER_LOG(Request, Info, "%s %s", req.path.c_str(), req.body.c_str());
+
+    // Retrieve task creation info from request body
+    auto requested_duration = req_body["job"]["durationInSec"].get<double>();
+    auto num_nodes = req_body["job"]["numNodes"].get<int>();
+    json body;
+    if (!isValidJob(num_nodes, requested_duration))
+    {
+        res.status = 400;
+        body["time"] = simulation_clock.now();
+        body["success"] = false;
+        res.set_header("access-control-allow-origin", "*");
+        res.set_content(body.dump(), "application/json");
+        return;
+    }
+    double actual_duration = (double)pp_seqwork + ((double)pp_parwork / num_nodes);
+
+    // Pass parameters in to function to add a job.
+    std::string jobID;
+    {
+        std::unique_lock<std::mutex> lock(submission_mutex);
+        jobID = simulation_thread_state->addJob(requested_duration, num_nodes, actual_duration);
+        journal.recordJob(simulation_thread_state->getSimulationTime(), jobID, num_nodes, requested_duration);
+    }
+
+    // Retrieve the return value from adding ajob to determine if successful.
+    if(!jobID.empty())
+    {
+        body["time"] = simulation_clock.now();
+        body["jobID"] = jobID;
+        body["success"] = true;
+    }
+    else
+    {
+        body["time"] = simulation_clock.now();
+        body["success"] = false;
+    }
+
+    res.set_header("access-control-allow-origin", "*");
+    res.set_content(body.dump(), "application/json");
+}
+
+/**
+ * @brief Path handling adding a batch of jobs to the simulated batch scheduler in one request.
+ *
+ * @param req HTTP request object
+ * @param res HTTP response object
+ */
+void addJobs(const Request& req, Response& res)
+{
+    json req_body = json::parse(req.body);
+    SERVER_LOG(Request, Info, "%s %s", req.path.c_str(), req.body.c_str());
+
+    // Retrieve task creation info of each job from request body
+    std::vector<std::tuple<double, unsigned int, double>> job_specs;
+    for (auto const &job : req_body["jobs"])
+    {
+        auto requested_duration = job["durationInSec"].get<double>();
+        auto num_nodes = job["numNodes"].get<int>();
+        if (!isValidJob(num_nodes, requested_duration))
+        {
+            json body;
+            res.status = 400;
+            body["time"] = simulation_clock.now();
+            body["success"] = false;
+            res.set_header("access-control-allow-origin", "*");
+            res.set_content(body.dump(), "application/json");
+            return;
+        }
+        double actual_duration = (double)pp_seqwork + ((double)pp_parwork / num_nodes);
+        job_specs.emplace_back(requested_duration, num_nodes, actual_duration);
+    }
+
+    // Pass parameters in to function to add all jobs at once.
+    std::vector<std::string> jobIDs;
+    {
+        std::unique_lock<std::mutex> lock(submission_mutex);
+        jobIDs = simulation_thread_state->addJobs(job_specs);
+        double now = simulation_thread_state->getSimulationTime();
+        for (size_t i = 0; i < jobIDs.size(); i++)
+            journal.recordJob(now, jobIDs[i], std::get<1>(job_specs[i]), std::get<0>(job_specs[i]));
+    }
+
+    // Jobs that could not be added have a null ID
+    json body;
+    body["time"] = simulation_clock.now();
+    body["jobIDs"] = json::array();
+    body["success"] = true;
+    for (auto const &jobID : jobIDs)
+    {
+        if (jobID.empty())
+        {
+            body["jobIDs"].push_back(nullptr);
+            body["success"] = false;
+        }
+        else
+        {
+            body["jobIDs"].push_back(jobID);
+        }
+    }
+
+    res.set_header("access-control-allow-origin", "*");
+    res.set_content(body.dump(), "application/json");
+}
+
+/**
+ * @brief Path handling canceling a job from the simulated batch scheduler.
+ * 
  * @param req HTTP request object
  * @param res HTTP response object
  */
 void cancelJob(const Request& req, Response& res)
 {
     json req_body = json::parse(req.body);
-    std::printf("Path: %s\nBody: %s\n\n", req.path.c_str(), req.body.c_str());
+    SERVER_LOG(Request, Info, "%s %s", req.path.c_str(), req.body.c_str());
     json body;
-    body["time"] = get_time() - time_start;
+    body["time"] = simulation_clock.now();
     body["success"] = false;
     // Send cancel job to wms and set success in job cancelation if can be done.
     if(simulation_thread_state->cancelJob(req_body["jobName"].get<std::string>()))
+    {
         body["success"] = true;
+        journal.recordCancel(simulation_thread_state->getSimulationTime(), req_body["jobName"].get<std::string>());
+    }
 
     res.set_header("access-control-allow-origin", "*");
     res.set_content(body.dump(), "application/json");
 }
 
+/**
+ * @brief Periodically reports the CPU time used by this session (i.e., this process), which
+ * is useful to measure the overhead of idle sessions, along with the depth counters of the
+ * queues between the web server and simulation threads.
+ *
+ * @param interval Reporting interval in seconds.
+ */
+void reportCpuUsage(int interval)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    double last_cpu_time = ts.tv_sec + ts.tv_nsec / 1e9;
+    unsigned long last_num_wakeups = 0;
+
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(interval));
+
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        double cpu_time = ts.tv_sec + ts.tv_nsec / 1e9;
+        unsigned long num_wakeups = simulation_thread_state->getNumWakeups();
+        SERVER_LOG(Server, Info, "CPU usage: %.2f%% over the last %d seconds (%lu simulation wakeups)",
+                   100.0 * (cpu_time - last_cpu_time) / interval, interval, num_wakeups - last_num_wakeups);
+        for (auto const &depth : simulation_thread_state->getQueueDepths()) {
+            SERVER_LOG(Server, Info, "Queue %s: depth %zu, max depth %zu, %lu rejected", depth.first.c_str(),
+                       std::get<0>(depth.second), std::get<1>(depth.second), std::get<2>(depth.second));
+        }
+        last_cpu_time = cpu_time;
+        SERVER_LOG(Server, Info, "HTTP: %lu overflowed connections, %lu slow requests and %lu streams shed so far",
+                   AdmissionQueue::getNumOverflowed(), slow_requests.getNumRejected(),
+                   stream_requests.getNumRejected());
+        last_num_wakeups = num_wakeups;
+    }
+}
+
+/**
+ * @brief Drives the simulation in the background so that it follows the server simulated time,
+ * independently of how often clients poll. Wakes up whenever the server time reaches the next
+ * simulated second, but at most 100 times per wall-clock second.
+ */
+void driveSimulation()
+{
+    // Wait for the simulation to be launched
+    while (!simulation_thread_state->waitUntilReady(ADVANCE_TIMEOUT)) {}
+
+    if (*reset_request_time > 0) {
+        reset_duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count() - *reset_request_time;
+        SERVER_LOG(Server, Info, "Simulation reset in %.0f ms", reset_duration.load());
+    }
+    SERVER_LOG(Server, Info, "Startup: %s; simulation: %s", startup_phases.toString().c_str(),
+               simulation_thread_state->getStartupPhases().toString().c_str());
+
+    time_t last_server_time = -1;
+    while (true) {
+        // Only wake up the simulation when the server time has changed (e.g., not when paused)
+        time_t now = simulation_clock.now();
+        if (now / 1000 != last_server_time) {
+            last_server_time = now / 1000;
+            simulation_thread_state->setServerTime(last_server_time);
+        }
+
+        // Sleep until the next simulated second (a paused clock is checked once per second)
+        double wait = 1000;
+        if (!simulation_clock.isPaused()) {
+            wait = (double)(1000 - now % 1000) / simulation_clock.getSpeed();
+        }
+        wait = std::min(std::max(wait, 10.0), 1000.0);
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(wait));
+    }
+}
+
+/**
+ * @brief Pauses the server simulated time when no request has been received for a while, and no
+ * event stream is open (e.g., the browser tab was closed), so that the simulation stops advancing.
+ * The clock is resumed by the next request (see recordActivity()).
+ *
+ * @param timeout Number of seconds without requests after which to pause.
+ */
+void pauseWhenIdle(int timeout)
+{
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        time_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (!idle_paused && !simulation_clock.isPaused() && now - last_request_time > timeout * 1000) {
+            SERVER_LOG(Server, Info, "No request in %d seconds, pausing the simulation", timeout);
+            idle_paused = true;
+            simulation_clock.pause();
+        }
+    }
+}
+
+/**
+ * @brief Logger called after each request, which records activity and resumes the server
+ * simulated time if it was paused for lack of requests.
+ *
+ * @param req HTTP request object
+ * @param res HTTP response object
+ */
+void recordRequest(const Request& req, const Response& res)
+{
+    recordActivity();
+}
+
+/**
+ * @brief Logger called after each request has been answered, which ends the session right after
+ * answering a request that reset the simulation, rather than waiting for the other connections
+ * (e.g., event streams and idle keep-alive connections) to close.
+ *
+ * @param req HTTP request object
+ * @param res HTTP response object
+ */
+void afterRequest(const Request& req, const Response& res)
+{
+    if (idle_pause_timeout > 0) {
+        recordRequest(req, res);
+    }
+    if (simulation_reset && (req.path == "/api/reset" || req.path == "/api/start")) {
+        SERVER_LOG(Server, Info, "Session ended after %lld ms of reset",
+                   std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch()).count() - *reset_request_time);
+        server_log.stop();
+        _exit(SIMULATION_RESET);
+    }
+}
+
+/**
+ * @brief Path handling CORS preflight requests, which browsers send before cross-origin requests
+ * with headers such as If-None-Match.
+ *
+ * @param req HTTP request object
+ * @param res HTTP response object
+ */
+void preflight(const Request& req, Response& res)
+{
+    res.set_header("Access-Control-Allow-Origin", "*");
+    res.set_header("Access-Control-Allow-Methods", "GET, POST");
+    res.set_header("Access-Control-Allow-Headers", "Content-Type, If-None-Match");
+    res.set_header("Access-Control-Max-Age", "86400");
+}
+
+/**
+ * @brief Path handling the client files (see AssetCache).
+ *
+ * @param req HTTP request object
+ * @param res HTTP response object
+ */
+void getAsset(const Request& req, Response& res)
+{
+    asset_cache.serve(req, res);
+}
+
 // ERROR HANDLING
 
 /**
@@ -324,19 +1343,339 @@ void cancelJob(const Request& req, Response& res)
  */
 void error_handling(const Request& req, Response& res)
 {
-    std::printf("%d: %s|%s\n", res.status, req.path.c_str(), req.body.c_str());
+    SERVER_LOG(Request, Warning, "%d: %s|%s", res.status, req.path.c_str(), req.body.c_str());
+}
+
+// HEADLESS MODE
+
+/**
+ * @brief A user job submitted by a headless script, along with what happened to it.
+ */
+struct HeadlessJob {
+    std::string name;
+    int num_nodes;
+    double requested_duration;
+    std::string status = "pending";
+    double submit_date = -1;
+    double start_date = -1;
+    double end_date = -1;
+};
+
+/**
+ * @brief Records the job events retrieved from the simulation into the headless jobs.
+ *
+ * @param status Queue of job events as retrieved by getEventStatuses().
+ * @param jobs Headless jobs.
+ * @param job_indices Index of each headless job keyed by job name.
+ */
+void recordHeadlessEvents(std::queue<wrench::JobEvent>& status, std::vector<HeadlessJob>& jobs,
+                          std::map<std::string, size_t>& job_indices)
+{
+    while (!status.empty())
+    {
+        const auto &event = status.front();
+        if (job_indices.find(event.job_name) != job_indices.end())
+        {
+            auto &job = jobs[job_indices[event.job_name]];
+            job.status = (event.type == wrench::JobEvent::COMPLETED ? "completed" : "failed");
+            job.submit_date = event.submit_date;
+            job.start_date = event.start_date;
+            job.end_date = event.end_date;
+        }
+        status.pop();
+    }
+}
+
+/**
+ * @brief Jobs submitted by a script of actions, and how far the script has advanced the simulation.
+ */
+struct ScriptRun {
+    std::vector<HeadlessJob> jobs;
+    std::map<std::string, size_t> job_indices;
+    std::queue<wrench::JobEvent> status;
+    double now = 0;
+};
+
+/**
+ * @brief Advances the simulation to the given time while recording job events.
+ *
+ * @param run Script run
+ * @param time Simulated time in seconds
+ * @return true on success, false if the simulation did not catch up in time.
+ */
+bool advanceScript(ScriptRun& run, double time)
+{
+    auto advance = simulation_thread_state->setServerTime(time);
+    if (!simulation_thread_state->waitForAdvance(advance, ADVANCE_TIMEOUT))
+    {
+        cerr << "Error: Simulation did not catch up within " << ADVANCE_TIMEOUT << " seconds\n";
+        return false;
+    }
+    simulation_thread_state->getEventStatuses(run.status);
+    recordHeadlessEvents(run.status, run.jobs, run.job_indices);
+    run.now = std::max(run.now, time);
+    return true;
+}
+
+/**
+ * @brief Runs a script of timestamped actions against the simulation as fast as possible.
+ *
+ * Each script line is "<time in seconds> <action> [arguments]", with actions:
+ *   - sbatch <num nodes> <requested duration in seconds>
+ *   - scancel <index of the sbatch action in the script, starting at 1>
+ *   - skip <number of seconds>
+ * Blank lines and lines starting with '#' are ignored.
+ *
+ * @param script Script
+ * @param script_path Path to the script (for error messages).
+ * @param run Script run, which the submitted jobs are added to.
+ * @return true on success, false on error.
+ */
+bool runScript(std::istream& script, const std::string& script_path, ScriptRun& run)
+{
+    auto &jobs = run.jobs;
+    auto &job_indices = run.job_indices;
+    auto &now = run.now;
+    auto advance_to = [&run](double time) { return advanceScript(run, time); };
+    bool success = true;
+
+    std::string line;
+    int line_number = 0;
+    while (success && std::getline(script, line))
+    {
+        line_number++;
+        std::istringstream tokens(line);
+        double time;
+        std::string action;
+        if (!(tokens >> time))
+        {
+            // Blank lines and comments
+            if (line.find_first_not_of(" \t\r") == std::string::npos || line[line.find_first_not_of(" \t")] == '#')
+                continue;
+            cerr << "Error: Invalid time at line " << line_number << " of " << script_path << "\n";
+            success = false;
+            break;
+        }
+        tokens >> action;
+        if (time < now)
+        {
+            cerr << "Error: Time going backward at line " << line_number << " of " << script_path << "\n";
+            success = false;
+            break;
+        }
+        if (!advance_to(time))
+        {
+            success = false;
+            break;
+        }
+
+        if (action == "sbatch")
+        {
+            HeadlessJob job;
+            if (!(tokens >> job.num_nodes >> job.requested_duration) || job.num_nodes < 1)
+            {
+                cerr << "Error: Invalid sbatch arguments at line " << line_number << " of " << script_path << "\n";
+                success = false;
+                break;
+            }
+            double actual_duration = (double)pp_seqwork + ((double)pp_parwork / job.num_nodes);
+            job.name = simulation_thread_state->addJob(job.requested_duration, job.num_nodes, actual_duration);
+            if (job.name.empty())
+                job.status = "rejected";
+            else
+                job_indices[job.name] = jobs.size();
+            jobs.push_back(job);
+        }
+        else if (action == "scancel")
+        {
+            size_t index;
+            if (!(tokens >> index) || index < 1 || index > jobs.size())
+            {
+                cerr << "Error: Invalid scancel argument at line " << line_number << " of " << script_path << "\n";
+                success = false;
+                break;
+            }
+            auto &job = jobs[index - 1];
+            if (!job.name.empty() && simulation_thread_state->cancelJob(job.name))
+            {
+                job.status = "cancelled";
+                job.end_date = time;
+            }
+        }
+        else if (action == "skip")
+        {
+            double increment;
+            if (!(tokens >> increment) || increment < 0)
+            {
+                cerr << "Error: Invalid skip argument at line " << line_number << " of " << script_path << "\n";
+                success = false;
+                break;
+            }
+            success = advance_to(time + increment);
+        }
+        else
+        {
+            cerr << "Error: Unknown action " << action << " at line " << line_number << " of " << script_path << "\n";
+            success = false;
+        }
+    }
+    return success;
+}
+
+/**
+ * @brief Runs a script of timestamped actions (see runScript()) against the simulation as fast as
+ * possible, without serving any client, and writes a JSON report of what happened to each job.
+ * Once the script is over, the simulation runs until all jobs are done.
+ *
+ * @param script_path Path to the script.
+ * @param report_path Path to the JSON report ("-" for standard output).
+ * @return int SIMULATION_END on success, 1 on error.
+ */
+int runHeadless(const std::string& script_path, const std::string& report_path)
+{
+    std::ifstream script(script_path);
+    if (!script)
+    {
+        cerr << "Error: Cannot open headless script " << script_path << "\n";
+        return 1;
+    }
+
+    // Start the simulation in a separate thread and wait for it to be ready for jobs
+    simulation_thread_state = new SimulationThreadState();
+    simulation_thread = std::thread(&SimulationThreadState::createAndLaunchSimulation,
+                                    simulation_thread_state, original_argc, original_argv,
+                                    num_cluster_nodes, num_cores_per_node, tracefile_scheme,
+                                    advance_mode == "event");
+    if (!simulation_thread_state->waitUntilReady(ADVANCE_TIMEOUT))
+    {
+        cerr << "Error: Simulation did not start within " << ADVANCE_TIMEOUT << " seconds\n";
+        exit(1);
+    }
+
+    ScriptRun run;
+    auto &jobs = run.jobs;
+    auto &job_indices = run.job_indices;
+    auto &status = run.status;
+    auto &now = run.now;
+    bool success = runScript(script, script_path, run);
+
+    // Run until all jobs are done
+    while (success && simulation_thread_state->hasPendingJobs())
+    {
+        auto advance = simulation_thread_state->advanceToNextJobEvent(now + NEXT_EVENT_MAX_INCREMENT);
+        if (!simulation_thread_state->waitForAdvance(advance, ADVANCE_TIMEOUT))
+        {
+            cerr << "Error: Simulation did not catch up within " << ADVANCE_TIMEOUT << " seconds\n";
+            success = false;
+            break;
+        }
+        now = simulation_thread_state->getSimulationTime();
+        simulation_thread_state->getEventStatuses(status);
+        recordHeadlessEvents(status, jobs, job_indices);
+    }
+
+    // Write the report
+    if (success)
+    {
+        json report;
+        report["time"] = now;
+        report["jobs"] = json::array();
+        for (auto const &job : jobs)
+        {
+            json job_report;
+            job_report["name"] = job.name;
+            job_report["numNodes"] = job.num_nodes;
+            job_report["durationInSec"] = job.requested_duration;
+            job_report["status"] = job.status;
+            job_report["submit"] = job.submit_date;
+            job_report["start"] = job.start_date;
+            job_report["end"] = job.end_date;
+            report["jobs"].push_back(job_report);
+        }
+
+        if (report_path == "-")
+        {
+            std::cout << report.dump(2) << "\n";
+        }
+        else
+        {
+            std::ofstream report_file(report_path);
+            report_file << report.dump(2) << "\n";
+            if (!report_file)
+            {
+                cerr << "Error: Cannot write headless report " << report_path << "\n";
+                success = false;
+            }
+        }
+    }
+
+    // Stop the simulation and join with its thread
+    simulation_thread_state->stopSimulation();
+    simulation_thread.join();
+
+    return (success ? SIMULATION_END : 1);
+}
+
+/**
+ * @brief Opens the journal and, if it is not empty (i.e., the previous session crashed), replays
+ * it as fast as possible to rebuild the state of the previous session, including its simulated
+ * time. If the replay fails, the journal is cleared and this session starts from scratch. If the
+ * session that replayed the journal crashed before any new action (i.e., the journal itself most
+ * likely makes the server crash), the journal is set aside instead of being replayed again.
+ */
+void replayJournal()
+{
+    if (!journal.open(journal_path))
+    {
+        SERVER_LOG(Server, Error, "Cannot open journal %s: %s", journal_path.c_str(), strerror(errno));
+        return;
+    }
+    std::string content = journal.getContent();
+    if (!content.empty() && Journal::isReplayPending(content))
+    {
+        SERVER_LOG(Server, Error, "Session crashed after replaying journal %s, moving it to %s%s and starting "
+                                  "from scratch", journal_path.c_str(), journal_path.c_str(), JOURNAL_FAILED_SUFFIX);
+        if (!journal.setAside(JOURNAL_FAILED_SUFFIX))
+        {
+            SERVER_LOG(Server, Error, "Cannot move journal %s aside, clearing it", journal_path.c_str());
+        }
+        content.clear();
+    }
+    if (content.empty())
+    {
+        journal.recordSeed(rng_seed);
+        return;
+    }
+
+    SERVER_LOG(Server, Warning, "Recovering the previous session from journal %s", journal_path.c_str());
+    journal.recordReplay();
+    auto begin = PhaseTimer::now();
+    ScriptRun run;
+    std::istringstream script(content);
+    if (!simulation_thread_state->waitUntilReady(ADVANCE_TIMEOUT) || !runScript(script, journal_path, run))
+    {
+        SERVER_LOG(Server, Error, "Cannot replay journal %s, starting from scratch", journal_path.c_str());
+        journal.clear();
+        server_log.stop();
+        _exit(SIMULATION_RESET);
+    }
+    for (const auto &job : run.jobs)
+        journal.restoreJob(job.name);
+    simulation_clock.advanceTo((time_t)(run.now * 1000));
+
+    auto end = startup_phases.record("replay", begin);
+    SERVER_LOG(Server, Warning, "Recovered %zu jobs up to simulated time %.0f in %.0f ms", run.jobs.size(), run.now,
+               std::chrono::duration<double, std::milli>(end - begin).count());
 }
 
 /**
- * @brief Real main function
+ * @brief Parses the command-line arguments into the globals, once for all sessions.
  * @param argc
  * @param argv
- * @return
+ * @return true if the server should run, false otherwise (help message or invalid arguments).
  */
-int real_main(int argc, char **argv)
+bool parse_arguments(int argc, char **argv)
 {
-    int port_number;
-
     // Save the arguments
     original_argc = argc;
     original_argv = (char **) calloc(argc, sizeof(char *));
@@ -373,6 +1712,31 @@ int real_main(int argc, char **argv)
                     in(1, INT_MAX, "pp_parwork")), "parallel program's parallelizable work in seconds")
             ("port", po::value<int>()->default_value(80)->notifier(
                     in(1, INT_MAX, "port")), "server port (if 80, may need to sudo)")
+            ("advance", po::value<std::string>()->default_value("event"), "simulated time advance mode (event: jump to next event, tick: 1-second increments)")
+            ("headless", po::value<std::string>(), "run the actions in this script as fast as possible instead of serving clients")
+            ("report", po::value<std::string>()->default_value("report.json"), "path to the JSON job report written in headless mode (- for standard output)")
+            ("speed", po::value<double>()->default_value(1.0)->notifier(
+                    in(MIN_SPEED, MAX_SPEED, "speed")), "number of simulated seconds per wall-clock second")
+            ("idle-pause", po::value<int>()->default_value(0)->notifier(
+                    in(0, INT_MAX, "idle-pause")), "number of seconds without requests after which simulated time is paused (0 means never)")
+            ("cpu-report", po::value<int>()->default_value(0)->notifier(
+                    in(0, INT_MAX, "cpu-report")), "interval in seconds at which to report this session's CPU usage (0 means never)")
+            ("http-threads", po::value<int>()->default_value(CPPHTTPLIB_THREAD_POOL_COUNT)->notifier(
+                    in(2, 1024, "http-threads")), "number of web server threads (half of them at most serve event streams "
+                                                  "and long polls, and a quarter at most wait for the simulation to catch up)")
+            ("http-queue", po::value<int>()->default_value(64)->notifier(
+                    in(1, 100000, "http-queue")), "maximum number of connections waiting for a web server thread, beyond "
+                                                  "which connections are turned away with a 503")
+            ("journal", po::value<std::string>()->default_value(""), "path to a journal of the actions of the current session, "
+                                                                      "replayed to recover the session if the server crashes "
+                                                                      "(default: no journal)")
+            ("seed", po::value<unsigned int>()->default_value(1), "seed of the random number generator used to generate "
+                                                                  "background jobs (the seed recorded in the journal, if any, "
+                                                                  "takes precedence)")
+            ("log", po::value<std::string>()->default_value(""), "comma-separated log levels (debug, info, warning, error, off), "
+                                                                  "either for all categories or as <category>=<level> "
+                                                                  "for the request, poll, simulation and server categories "
+                                                                  "(default: info, except poll=off)")
             ;
 
     po::variables_map vm;
@@ -381,7 +1745,7 @@ int real_main(int argc, char **argv)
         po::notify(vm);
     } catch (std::exception &e) {
         cerr << "Error: " << e.what() << "\n";
-        return 1;
+        return false;
     }
     num_cluster_nodes = vm["nodes"].as<int>();
     num_cores_per_node = vm["cores"].as<int>();
@@ -390,11 +1754,33 @@ int real_main(int argc, char **argv)
     pp_seqwork = vm["pp_seqwork"].as<int>();
     pp_parwork = vm["pp_parwork"].as<int>();
     port_number = vm["port"].as<int>();
+    advance_mode = vm["advance"].as<std::string>();
+    cpu_report_interval = vm["cpu-report"].as<int>();
+    idle_pause_timeout = vm["idle-pause"].as<int>();
+    http_threads = vm["http-threads"].as<int>();
+    http_queue = vm["http-queue"].as<int>();
+    if (vm.count("headless")) {
+        headless_script = vm["headless"].as<std::string>();
+    }
+    report_path = vm["report"].as<std::string>();
+    journal_path = vm["journal"].as<std::string>();
+    rng_seed = vm["seed"].as<unsigned int>();
+    simulation_clock.setSpeed(vm["speed"].as<double>());
 
     // Print help message and exit if needed
     if (vm.count("help")) {
         cout << desc << "\n";
-        return 1;
+        return false;
+    }
+
+    if (advance_mode != "event" and advance_mode != "tick") {
+        cerr << "Error: Unknown advance mode " << advance_mode << "\n";
+        return false;
+    }
+
+    if (not server_log.configure(vm["log"].as<std::string>())) {
+        cerr << "Error: Invalid log levels " << vm["log"].as<std::string>() << "\n";
+        return false;
     }
 
     // Print some logging
@@ -403,44 +1789,163 @@ int real_main(int argc, char **argv)
     cerr << "Parallel program is called " << pp_name << ".\n";
     cerr << "Its sequential work is " << pp_seqwork << " seconds.\n";
     cerr << "Its parallel work is " << pp_parwork << " seconds.\n";
+    cerr << "Simulated time advances in " << advance_mode << " mode, at " << simulation_clock.getSpeed() << "x speed.\n";
+    return true;
+}
+
+/**
+ * @brief Real main function, which runs one session (until the simulation is reset or stopped)
+ * @param activation_fd Pipe from which the parent process tells the session, prepared on standby,
+ * to start serving clients (unused in headless mode)
+ * @return
+ */
+int real_main(int activation_fd)
+{
+    auto phase_begin = PhaseTimer::now();
+    server_log.start();
+    phase_begin = startup_phases.record("logger", phase_begin);
+
+    // Same background jobs in all sessions (and in the replay of a journal)
+    srand(rng_seed);
+
+    // Run a script of actions instead of serving clients, if requested
+    if (!headless_script.empty()) {
+        return runHeadless(headless_script, report_path);
+    }
 
     // Handle GET requests
     server.Get("/api/time", getTime);
     server.Get("/api/query", getQuery);
+    server.Get("/api/events", getEvents);
+    server.Get("/api/diagnostics", getDiagnostics);
 
     // Handle POST requests
     server.Post("/api/start", start);
     server.Post("/api/stop", stop);
     server.Post("/api/reset", reset);
-    server.Post("/api/addTime", addTime);
+    server.Post("/api/addTime", admitSlow(addTime));
+    server.Post("/api/nextEvent", admitSlow(nextEvent));
+    server.Post("/api/setSpeed", setSpeed);
+    server.Post("/api/pause", pauseTime);
+    server.Post("/api/resume", resumeTime);
     server.Post("/api/addJob", addJob);
+    server.Post("/api/addJobs", addJobs);
     server.Post("/api/cancelJob", cancelJob);
     server.Post("/api/getQueue", getQueue);
+    server.Options("/api/.*", preflight);
+
+    // Serve requests with a bounded pool of threads, keeping some threads for cheap requests
+    stream_requests.setMaxRequests(std::max(1, http_threads / 2));
+    slow_requests.setMaxRequests(std::max(1, http_threads / 4));
+    server.new_task_queue = [] { return new AdmissionQueue(http_threads, http_queue); };
 
     // Set some generic error handler
     server.set_error_handler(error_handling);
 
-    // Path is relative so if you build in a different directory, you will have to change the relative path.
-    // Currently set so that it can try find the client directory in any location. 
-    // Current implementation would have a security risk
-    // since any file in that directory can be loaded.
-    server.set_mount_point("/", "../../client");
-    server.set_mount_point("/", "../client");
-    server.set_mount_point("/", ".client");
+    // Serve the client files from memory (any other GET path, hence registered last)
+    server.Get("/.*", getAsset);
+    phase_begin = startup_phases.record("routes", phase_begin);
 
-    // Start the simulation in a separate thread
+    // Create the simulation in a separate thread, which launches it once the session is activated
     simulation_thread_state = new SimulationThreadState();
+    simulation_thread_state->holdLaunch();
     simulation_thread = std::thread(&SimulationThreadState::createAndLaunchSimulation,
                                     simulation_thread_state, original_argc, original_argv,
-                                    num_cluster_nodes, num_cores_per_node, tracefile_scheme);
+                                    num_cluster_nodes, num_cores_per_node, tracefile_scheme,
+                                    advance_mode == "event");
+    phase_begin = startup_phases.record("simulation thread", phase_begin);
+
+    // Wait on standby until the previous session is over (see main()), or exit if the parent
+    // process no longer needs this session
+    char go;
+    if (read(activation_fd, &go, 1) != 1) {
+        server_log.stop();
+        _exit(SIMULATION_END);
+    }
+    close(activation_fd);
+    startup_phases.recordWait("standby", phase_begin);
+
+    // Set the start time
+    simulation_clock.start();
+    session_tag = std::to_string(getpid()) + "." + std::to_string(
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count());
+    simulation_thread_state->releaseLaunch();
+
+    // Rebuild the state of a previous session that crashed, if any
+    if (!journal_path.empty()) {
+        replayJournal();
+    }
+
+    // Keep the simulation up to date with the server time
+    std::thread(driveSimulation).detach();
+
+    // Pause the simulated time of idle sessions if needed
+    if (idle_pause_timeout > 0) {
+        recordActivity();
+        std::thread(pauseWhenIdle, idle_pause_timeout).detach();
+    }
+    server.set_logger(afterRequest);
+
+    // Start reporting CPU usage if needed
+    if (cpu_report_interval > 0) {
+        std::thread(reportCpuUsage, cpu_report_interval).detach();
+    }
+
+    // Only accept connections once the simulation is ready, as request handlers use its WMS (connections
+    // wait in the backlog of the listening socket meanwhile)
+    while (!simulation_thread_state->waitUntilReady(ADVANCE_TIMEOUT)) {
+        SERVER_LOG(Server, Warning, "Simulation not ready after %d seconds", ADVANCE_TIMEOUT);
+    }
 
     // Start the server
-    std::printf("Listening on port: %d\n", port_number);
-    server.listen("0.0.0.0", port_number);
+    if (!acceptFromListener()) {
+        SERVER_LOG(Server, Error, "Cannot accept connections on port %d", port_number);
+        return 1;
+    }
+    server.listen_after_bind();
 
     return (simulation_reset ? SIMULATION_RESET : SIMULATION_END);
 }
 
+/**
+ * @brief Starts a session on standby, which prepares its simulation and waits to be activated.
+ * @param activation_fd Set to the pipe to which to write a byte to activate the session (and to
+ * close without writing to let it go)
+ * @return pid_t Process ID of the session, or -1 on failure.
+ */
+pid_t forkSession(int &activation_fd)
+{
+    int fds[2];
+    if (pipe(fds) < 0) {
+        std::cerr << "Error: Cannot create pipe: " << strerror(errno) << "\n";
+        return -1;
+    }
+    pid_t child = fork();
+    if (!child) {
+        close(fds[1]);
+        // Setup a handled for segfault, while waiting to figure out
+        // why rapid-fire simulation resets cause segfaults on Mac even
+        // though valgrind shows no problems in linux
+        signal(SIGSEGV, signal_handler);
+        // Only the parent removes the platform files, which the sessions share
+        setTerminationHandler(SIG_DFL);
+        // Call the real main function which returns:
+        //  - SIMULATION_END if simulation should stop
+        //  - SIMULATION_RESET if simulation should reset and restart
+        int ret_value = real_main(fds[0]);
+        exit(ret_value);
+    }
+    close(fds[0]);
+    if (child < 0) {
+        std::cerr << "Error: Cannot fork: " << strerror(errno) << "\n";
+        close(fds[1]);
+        return -1;
+    }
+    activation_fd = fds[1];
+    return child;
+}
+
 /**
  * @brief Main function
  * @param argc
@@ -450,26 +1955,94 @@ int real_main(int argc, char **argv)
 
 int main(int argc, char **argv) {
 
-    // Loop that keeps restarting the server every time it stops
-    // due to a simulation reset
-    while (true) {
-        pid_t child = fork();
-        if (!child) {
-            // Set the start time
-            time_start = get_time();
-            // Setup a handled for segfault, while waiting to figure out
-            // why rapid-fire simulation resets cause segfaults on Mac even
-            // though valgrind shows no problems in linux
-            signal(SIGSEGV, signal_handler);
-            // Call the real main function which returns:
-            //  - SIMULATION_END if simulation should stop
-            //  - SIMULATION_RESET if simulation should reset and restart
-            int ret_value = real_main(argc, argv);
-            exit(ret_value);
+    auto phase_begin = PhaseTimer::now();
+    if (!parse_arguments(argc, argv)) {
+        return 1;
+    }
+    phase_begin = startup_phases.record("arguments", phase_begin);
+
+    // Generate the same background jobs as the session to recover, if any
+    if (!journal_path.empty()) {
+        std::ifstream journal_file(journal_path);
+        std::stringstream content;
+        content << journal_file.rdbuf();
+        if (Journal::parseSeed(content.str(), rng_seed)) {
+            std::cerr << "Journal " << journal_path << " found, using its seed " << rng_seed << ".\n";
         }
+    }
+
+    // Bind the port once for all sessions (connections made during a reset wait in its backlog)
+    if (headless_script.empty()) {
+        listener = bindListener(port_number);
+        if (listener < 0) {
+            std::cerr << "Error: Cannot listen on port " << port_number << ": " << strerror(errno) << "\n";
+            return 1;
+        }
+        std::cerr << "Listening on port " << port_number << ".\n";
+        phase_begin = startup_phases.record("listener", phase_begin);
+    }
+
+    // Shared with the sessions, which report the latency of resets
+    void *shared = mmap(nullptr, sizeof(std::atomic<long long>), PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        std::cerr << "Error: Cannot map shared memory: " << strerror(errno) << "\n";
+        return 1;
+    }
+    reset_request_time = new (shared) std::atomic<long long>(0);
+
+    // Load the client files once for all sessions. Paths are relative so if you build in a
+    // different directory, you will have to change them. Currently set so that it can find the
+    // client directory in any location.
+    if (asset_cache.load({"../../client", "../client", ".client"})) {
+        std::cerr << "Serving " << asset_cache.getNumFiles() << " client files from " << asset_cache.getDirectory()
+                  << " (" << asset_cache.getSize() << " bytes, " << asset_cache.getCompressedSize() << " compressed).\n";
+    } else {
+        std::cerr << "Warning: Client directory not found, only serving the API.\n";
+    }
+    phase_begin = startup_phases.record("client files", phase_begin);
+
+    // Write the platform file once for all sessions
+    std::string platform_file = SimulationThreadState::getPlatformFile(num_cluster_nodes, num_cores_per_node);
+    auto platform_end = startup_phases.record("platform file", phase_begin);
+    std::cerr << "Platform file " << platform_file << " written in "
+              << std::chrono::duration<double, std::milli>(platform_end - phase_begin).count()
+              << " ms (saved on each reset).\n";
+    setTerminationHandler(termination_signal_handler);
+
+    // Run the script in this process, there is no reset in headless mode
+    if (!headless_script.empty()) {
+        simulation_clock.start();
+        int ret_value = real_main(-1);
+        setTerminationHandler(SIG_DFL);
+        SimulationThreadState::removePlatformFiles();
+        return (ret_value == SIMULATION_END ? 0 : 1);
+    }
+
+    // A session on standby may be gone by the time it is activated (its exit code then tells why)
+    signal(SIGPIPE, SIG_IGN);
+
+    // Loop that keeps starting a new session every time one stops
+    // due to a simulation reset (the listening socket stays open). The
+    // next session is always prepared on standby in the meantime
+    int standby_fd;
+    pid_t standby = forkSession(standby_fd);
+    while (standby > 0) {
+        // Activate the standby session, and prepare the next one
+        pid_t child = standby;
+        if (write(standby_fd, "", 1) != 1) {
+            std::cerr << "Warning: Session on standby is gone\n";
+        }
+        close(standby_fd);
+        standby = forkSession(standby_fd);
 
         int exit_code = 0;
         waitpid(child, &exit_code, 0);
+        if (WIFSIGNALED(exit_code)) {
+            // Crashed, the next session recovers it from the journal
+            std::cerr << "Session killed by signal " << WTERMSIG(exit_code) << "!\n";
+            continue;
+        }
         exit_code = WEXITSTATUS(exit_code);
 
         if (exit_code == SIMULATION_RESET) {
@@ -479,5 +2052,13 @@ int main(int argc, char **argv) {
             break;
         }
     }
+
+    // Let the session on standby go
+    if (standby > 0) {
+        close(standby_fd);
+        waitpid(standby, nullptr, 0);
+    }
+    setTerminationHandler(SIG_DFL);
+    SimulationThreadState::removePlatformFiles();
     exit(0);
 }
@@ -1,4 +1,5 @@
 #include "workflow_manager.h"
+#include "AsyncLogger.h"
 
 #include <random>
 #include <iostream>
@@ -41,6 +42,7 @@ namespace wrench {
      * @param node_count Integer value holding the number of nodes the computer has.
      * @param core_count Integer value holding the number of cores per node.
      * @param background_jobs  Background job to start first!
+     * @param event_driven_advance Whether to advance time straight to the next event rather than in 1-second ticks.
      */
     WorkflowManager::WorkflowManager(
             const std::set<std::shared_ptr<ComputeService>> &compute_services,
@@ -48,15 +50,19 @@ namespace wrench {
             const std::string &hostname,
             const int node_count,
             const int core_count,
-            std::vector<std::tuple<int,int>> background_jobs) :
-            node_count(node_count), core_count(core_count), background_jobs(background_jobs) , WMS(
+            std::vector<std::tuple<int,int>> background_jobs,
+            const bool event_driven_advance) :
+            node_count(node_count), core_count(core_count), background_jobs(background_jobs),
+            event_driven_advance(event_driven_advance), WMS(
             nullptr, nullptr,
             compute_services,
             storage_services,
             {}, nullptr,
             hostname,
             "WorkflowManager"
-    ) { }
+    ) {
+        published_queue = std::make_shared<const QueueSnapshot>();
+    }
 
     /**
      * @brief Overridden main within WMS to handle the how jobs are processed. 
@@ -81,50 +87,71 @@ namespace wrench {
         }
 
 
+        // Let the web server thread know that jobs can now be added
+        queue_mutex.lock();
+        started = true;
+        queue_mutex.unlock();
+        advance_condition.notify_all();
+
         // Main loop handling the WMS implementation.
         while(true)
         {
-            // Add tasks onto the job_manager so it can begin processing them
-            while (!this->toSubmitJobs.empty())
+            // Take the cancellations before the jobs to submit, so that the job of each cancellation
+            // taken has been submitted (it was queued before its cancellation)
+            std::vector<std::string> to_cancel;
+            std::string job_name;
+            while (cancelJobs.pop(job_name))
+                to_cancel.push_back(std::move(job_name));
+
+            // Create the jobs requested by the user and add them onto the job_manager so it can begin processing them
+            std::vector<JobSpec> batch;
+            while (this->toSubmitJobs.pop(batch))
             {
-                // Retrieves the job to be submitted and set up needed arguments.
-                auto to_submit = this->toSubmitJobs.front();
-                auto job = std::get<0>(to_submit);
-                auto service_specific_args = std::get<1>(to_submit);
-
-                // Submit the job.
-                job_manager->submitJob(job, batch_service, service_specific_args);
-
-                // Lock the queue otherwise deadlocks might occur.
-                queue_mutex.lock();
-                this->toSubmitJobs.pop();
-                queue_mutex.unlock();
-                std::printf("Submit Server Time: %f\n", this->simulation->getCurrentSimulatedDate());
+                for (auto const &to_submit : batch)
+                {
+                    // Create tasks and add to workflow.
+                    auto task = this->getWorkflow()->addTask(
+                            "task_" + std::to_string(num_submitted_jobs++), to_submit.actual_duration, 1, 1, 0.0);
+
+                    // Create a job
+                    auto job = job_manager->createStandardJob(task, {});
+
+                    // Set up the command line arguments of slurm to submit job.
+                    std::map<std::string, std::string> service_specific_args;
+                    service_specific_args["-t"] = std::to_string(std::ceil(to_submit.requested_duration/60)); // In MINUTES!
+                    service_specific_args["-N"] = std::to_string(to_submit.num_nodes);
+                    service_specific_args["-c"] = std::to_string(1);
+                    service_specific_args["-u"] = "slurm_user";
+
+                    // Keep track of the job under the name returned to the user, for its events and cancellation
+                    user_jobs[to_submit.job_name] = job;
+                    user_job_names[job->getName()] = to_submit.job_name;
+
+                    // Submit the job.
+                    job_manager->submitJob(job, batch_service, service_specific_args);
+                    markQueueChanged();
+                    SERVER_LOG(Simulation, Debug, "Submit Server Time: %f", this->simulation->getCurrentSimulatedDate());
+                }
             }
 
-            // Clean up memory by removing completed and failed jobs
-            while(not doneJobs.empty())
-                doneJobs.pop();
-
             // Cancel jobs
-            while(not cancelJobs.empty())
+            for (auto const &name : to_cancel)
             {
+                // The job may have completed or failed since it was cancelled
+                auto it = user_jobs.find(name);
+                if (it == user_jobs.end())
+                    continue;
+                auto job = it->second;
+                user_job_names.erase(job->getName());
+                user_jobs.erase(it);
+
                 // Retrieve compute service and job to execute job termination.
-                auto batch_service = *(this->getAvailableComputeServices<BatchComputeService>().begin());
-                auto job_name = cancelJobs.front();
                 try {
-                    batch_service->terminateJob(job_list[job_name]);
+                    batch_service->terminateJob(job);
+                    markQueueChanged();
                 } catch (std::exception &e) {
-                    cerr << "EXCEPTION: " << e.what() << "\n";
+                    SERVER_LOG(Simulation, Warning, "Cannot terminate job %s: %s", name.c_str(), e.what());
                 }
-
-                // Remove from the map list of jobs
-                job_list.erase(job_name);
-
-                // Lock the queue otherwise deadlocks might occur.
-                queue_mutex.lock();
-                cancelJobs.pop();
-                queue_mutex.unlock();
             }
 
 
@@ -132,45 +159,254 @@ namespace wrench {
             // Needs to be done this way because waiting for next event cannot be done on another thread.
             while(this->simulationTime < server_time)
             {
-                // Retrieve event by going through sec increments.
-                auto event = this->waitForNextEvent(1.0);
+                // Retrieve event either by jumping straight to the earlier of the next event and
+                // the server time, or by going through sec increments.
+                double timeout = 1.0;
+                if (this->event_driven_advance) {
+                    timeout = server_time - this->simulationTime;
+                }
+                auto event = this->waitForNextEvent(timeout);
 //                WRENCH_INFO("TICK");
                 this->simulationTime = wrench::Simulation::getCurrentSimulatedDate();
 
                 // If no event keep going
                 if (event == nullptr) continue;
 
+                // Any job starting or ending changes the queue, including background jobs
+                markQueueChanged();
+
                 // If it's a pilot job event, it's about background jobs, we don't care
                 if (std::dynamic_pointer_cast<PilotJobStartedEvent>(event)) continue;
                 if (std::dynamic_pointer_cast<PilotJobExpiredEvent>(event)) continue;
 
                 if (event != nullptr)
                 {
-                    std::printf("Event Server Time: %f\n", this->simulation->getCurrentSimulatedDate());
-                    std::printf("Event: %s\n", event->toString().c_str());
-                    // Add job onto the event queue with locks to prevent deadlocks.
-                    queue_mutex.lock();
-                    events.push(std::make_pair(this->simulation->getCurrentSimulatedDate(), event));
-                    queue_mutex.unlock();
+                    SERVER_LOG(Simulation, Debug, "Event at server time %f: %s",
+                               this->simulation->getCurrentSimulatedDate(), event->toString().c_str());
+                    // Add the completion or failure of the job to the event log
+                    if (auto failed = std::dynamic_pointer_cast<wrench::StandardJobFailedEvent>(event))
+                    {
+                        recordJobEvent(failed->standard_job, JobEvent::FAILED);
+                    }
+                    else if (auto complete = std::dynamic_pointer_cast<wrench::StandardJobCompletedEvent>(event))
+                    {
+                        recordJobEvent(complete->standard_job, JobEvent::COMPLETED);
+                    }
+
+                    // If asked to advance only until the next user job event, this is it: stop here.
+                    if (next_event_deadline >= this->simulationTime) {
+                        next_event_deadline = -1.0;
+                        server_time = this->simulationTime.load();
+                        break;
+                    }
                 }
             }
 
+            // Publish the queue once the simulation has caught up, so that it includes the jobs that
+            // start in reaction to the changes above (e.g., a pending job starting when another one ends).
+            if (queue_changed) {
+                queue_changed = false;
+                publishQueueSnapshot();
+            }
+
+            // Block until the web server thread signals that there is something to do, rather
+            // than spinning, so that an idle session does not burn CPU cycles.
+            std::unique_lock<std::mutex> lock(queue_mutex);
+
+            // Let the web server thread know that the simulation has caught up with all
+            // the server time updates requested so far (the sequence number is read first since
+            // the web server thread updates the server time before bumping it).
+            unsigned long sequence = requested_sequence;
+            if (this->simulationTime >= server_time) {
+                completed_sequence = sequence;
+                advance_condition.notify_all();
+            }
+
+            // A request to advance until the next user job event is over once its deadline is reached
+            if (this->simulationTime >= next_event_deadline) {
+                next_event_deadline = -1.0;
+            }
+
+            // The web server thread only takes the mutex to notify us when we are asleep.
+            sleeping = true;
+            wakeup_condition.wait(lock, [this] { return this->hasWork(); });
+            sleeping = false;
+
             // Exits if server needs to stop
             if(stop)
                 break;
-            // Sleep since no matter what we're in locked step with real time and don't want
-            // to burn CPU cycles like crazy. Could probably sleep 1s...
-            usleep(100);
+            num_wakeups++;
         }
         return 0;
     }
 
+    /**
+     * @brief Checks whether the main loop has anything to do.
+     *
+     * @return true if there are jobs to submit or cancel, time to catch up, server time updates to
+     * acknowledge, or if the server needs to stop.
+     */
+    bool WorkflowManager::hasWork() const
+    {
+        return stop or
+               not toSubmitJobs.empty() or
+               not cancelJobs.empty() or
+               this->simulationTime < server_time or
+               completed_sequence < requested_sequence;
+    }
+
+    /**
+     * @brief Wakes up the simulation thread if it is asleep. Called by web server threads after they
+     * have made work available through one of the lock-free queues.
+     */
+    void WorkflowManager::wakeUp()
+    {
+        // The simulation thread sets the flag before checking for work, and the work was made available
+        // before we check the flag, so either it sees the work or we see that it may be asleep.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping) {
+            queue_mutex.lock();
+            queue_mutex.unlock();
+            wakeup_condition.notify_one();
+        }
+    }
+
+    /**
+     * @brief Retrieves the current depth, maximum depth, and number of rejected pushes of the queues
+     * between the web server and simulation threads.
+     *
+     * @return std::map<std::string, std::tuple<size_t, size_t, unsigned long>> Depth counters keyed by queue name.
+     */
+    std::map<std::string, std::tuple<size_t, size_t, unsigned long>> WorkflowManager::getQueueDepths() const
+    {
+        return {
+                {"toSubmitJobs", std::make_tuple(toSubmitJobs.size(), toSubmitJobs.highWaterMark(), toSubmitJobs.numRejected())},
+                {"cancelJobs", std::make_tuple(cancelJobs.size(), cancelJobs.highWaterMark(), cancelJobs.numRejected())}
+        };
+    }
+
+    /**
+     * @brief Waits until the simulation has caught up with a server time update.
+     *
+     * @param sequence Sequence number of the server time update, as returned by setServerTime().
+     * @param timeout Maximum time to wait in seconds.
+     * @return true if the simulation caught up (or is stopping), false if the timeout expired.
+     */
+    bool WorkflowManager::waitForAdvance(unsigned long sequence, double timeout)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        return advance_condition.wait_for(lock, std::chrono::duration<double>(timeout),
+                                          [this, sequence] { return stop or completed_sequence >= sequence; });
+    }
+
+    /**
+     * @brief Waits until the main loop has started, i.e., until jobs can be added.
+     *
+     * @param timeout Maximum time to wait in seconds.
+     * @return true if the main loop has started, false if the timeout expired.
+     */
+    bool WorkflowManager::waitUntilStarted(double timeout)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        return advance_condition.wait_for(lock, std::chrono::duration<double>(timeout),
+                                          [this] { return started or stop; });
+    }
+
+    /**
+     * @brief Waits until there are events not yet retrieved without a cursor, e.g., so that clients can
+     * long-poll for events.
+     *
+     * @param timeout Maximum time to wait in seconds.
+     * @return true if there are events (or the simulation is stopping), false if the timeout expired.
+     */
+    bool WorkflowManager::waitForEvents(double timeout)
+    {
+        std::unique_lock<std::mutex> lock(events_mutex);
+        return events_condition.wait_for(lock, std::chrono::duration<double>(timeout),
+                                         [this] { return last_event_sequence != cursor_without_client or stop; });
+    }
+
+    /**
+     * @brief Waits until there are events after some cursor in the event log.
+     *
+     * @param after Sequence number of the latest event the client already has.
+     * @param timeout Maximum time to wait in seconds.
+     * @return true if there are (possibly) new events (or the simulation is stopping), false if the timeout expired.
+     */
+    bool WorkflowManager::waitForEvents(unsigned long after, double timeout)
+    {
+        std::unique_lock<std::mutex> lock(events_mutex);
+        return events_condition.wait_for(lock, std::chrono::duration<double>(timeout),
+                                         [this, after] {
+                                             return last_event_sequence != after or stop;
+                                         });
+    }
+
+    /**
+     * @brief Checks whether the simulation has been asked to stop.
+     *
+     * @return true if stopping.
+     */
+    bool WorkflowManager::isStopping() const
+    {
+        return stop;
+    }
+
+    /**
+     * @brief Asks the simulation to advance until the next completion or failure of a user job, or
+     * until some maximum simulated time, whichever comes first.
+     *
+     * @param max_time Simulated time in seconds at which to stop if no user job event occurs before.
+     * @return unsigned long Sequence number of the server time update, to be passed to waitForAdvance().
+     */
+    unsigned long WorkflowManager::advanceToNextJobEvent(double max_time)
+    {
+        // The deadline is set before the server time so that the simulation thread cannot
+        // advance past a user job event without seeing it.
+        next_event_deadline = max_time;
+        double current_server_time = server_time;
+        while (max_time > current_server_time and
+               not server_time.compare_exchange_weak(current_server_time, max_time)) {}
+        unsigned long sequence = ++requested_sequence;
+        wakeUp();
+
+        return sequence;
+    }
+
+    /**
+     * @brief Checks whether some user jobs have not completed, failed, or been cancelled yet.
+     *
+     * @return true if there are pending user jobs.
+     */
+    bool WorkflowManager::hasPendingJobs()
+    {
+        std::lock_guard<std::mutex> lock(job_list_mutex);
+        return not job_list.empty();
+    }
+
+    /**
+     * @brief Retrieves the number of times the main loop woke up to do some work.
+     *
+     * @return unsigned long Number of wakeups since the simulation started.
+     */
+    unsigned long WorkflowManager::getNumWakeups() const
+    {
+        return num_wakeups;
+    }
+
     /**
      * @brief Sets the flag to stop the server since the web server and wms server run on two different threads.
      */
     void WorkflowManager::stopServer()
     {
         stop = true;
+        queue_mutex.lock();
+        queue_mutex.unlock();
+        wakeup_condition.notify_one();
+        advance_condition.notify_all();
+        events_mutex.lock();
+        events_mutex.unlock();
+        events_condition.notify_all();
     }
 
     /**
@@ -186,41 +422,77 @@ namespace wrench {
                                         const unsigned int& num_nodes,
                                         const double &actual_duration)
     {
-        static long task_id = 0;
-        // Check if valid number of nodes.
-        if(num_nodes > node_count)
-            return "";
-
-//        cerr << "requested " << requested_duration << "\n";
-//        cerr << "num_nodes " << num_nodes << "\n";
-//        cerr << "actual " << actual_duration << "\n";
+        auto job_name = queueJobs({std::make_tuple(requested_duration, num_nodes, actual_duration)}).front();
+        if (not job_name.empty())
+            wakeUp();
+        return job_name;
+    }
 
+    /**
+     * @brief Adds a batch of jobs to the simulation, which will all be submitted in the same
+     * iteration of the main loop.
+     *
+     * @param job_specs Requested duration, number of nodes, and actual duration of each job.
+     * @return std::vector<std::string> Name of each job, or empty string if failed to create.
+     */
+    std::vector<std::string> WorkflowManager::addJobs(const std::vector<std::tuple<double, unsigned int, double>>& job_specs)
+    {
+        auto job_names = queueJobs(job_specs);
 
-        // Create tasks and add to workflow.
-        auto task = this->getWorkflow()->addTask(
-                "task_" + std::to_string(task_id++), actual_duration, 1, 1, 0.0);
+        // Only wake up the simulation thread once all jobs are queued
+        wakeUp();
+        return job_names;
+    }
 
-        // Create a job
-        auto job = job_manager->createStandardJob(task, {});
+    /**
+     * @brief Names a batch of jobs and puts it in the queue of jobs to be created and submitted by the
+     * simulation thread as a single entry, so that the simulation thread takes all of them or none,
+     * without waking it up.
+     *
+     * @param job_specs Requested duration, number of nodes, and actual duration of each job.
+     * @return std::vector<std::string> Name of each job, or empty string if failed to create.
+     */
+    std::vector<std::string> WorkflowManager::queueJobs(const std::vector<std::tuple<double, unsigned int, double>>& job_specs)
+    {
+        std::vector<std::string> job_names;
+        std::vector<JobSpec> batch;
+
+        // Jobs are named, listed and queued at once, so that only jobs actually queued use up a name (and
+        // names are the same when the same jobs are added again, e.g., when replaying a journal)
+        std::lock_guard<std::mutex> lock(job_list_mutex);
+        unsigned long job_number = num_created_jobs;
+        for (auto const &job_spec : job_specs)
+        {
+            // Check if valid number of nodes.
+            if (std::get<1>(job_spec) > node_count) {
+                job_names.emplace_back();
+                continue;
+            }
 
-        // Set up the command line arguments of slurm to submit job.
-        std::map<std::string, std::string> service_specific_args;
-        service_specific_args["-t"] = std::to_string(std::ceil(requested_duration/60)); // In MINUTES!
-        service_specific_args["-N"] = std::to_string(num_nodes);
-        service_specific_args["-c"] = std::to_string(1);
-        service_specific_args["-u"] = "slurm_user";
+            JobSpec spec;
+            spec.job_name = "standard_job_" + std::to_string(++job_number);
+            spec.requested_duration = std::get<0>(job_spec);
+            spec.num_nodes = std::get<1>(job_spec);
+            spec.actual_duration = std::get<2>(job_spec);
+            job_names.push_back(spec.job_name);
+            batch.push_back(std::move(spec));
+        }
+        if (batch.empty())
+            return job_names;
 
-//        WRENCH_INFO("SUBMITTING : -t = %s", service_specific_args["-t"].c_str());
+        // Put into queue due to simulation and web server on separate threads. If the simulation thread
+        // is too far behind, refuse the jobs rather than blocking.
+        if (not toSubmitJobs.push(batch)) {
+            return std::vector<std::string>(job_specs.size());
+        }
 
-        // Lock the queue to prevent deadlock. Put into queue due to simulation and web server on separate threads.
-        queue_mutex.lock();
-        toSubmitJobs.push(std::make_pair(job, service_specific_args));
-        queue_mutex.unlock();
+        // Flag that there are jobs of these names created by the user needed for job cancellation. Done
+        // before the simulation thread can report their events, which needs the mutex.
+        num_created_jobs = job_number;
+        for (auto const &spec : batch)
+            job_list.insert(spec.job_name);
 
-        // Flag that there is a job of this name created by the user needed for job cancellation. Mapping name string
-        // to pointer of the job.
-        job_list[job->getName()] = job;
-        return job->getName();
+        return job_names;
     }
 
     /**
@@ -232,108 +504,226 @@ namespace wrench {
      */
     bool WorkflowManager::cancelJob(const std::string& job_name)
     {
-        // Search in hashtable for the job
-        if(job_list[job_name] != nullptr)
+        // Remove the job from the list of jobs so that no event is reported for it
+        job_list_mutex.lock();
+        bool user_job = job_list.erase(job_name) > 0;
+        job_list_mutex.unlock();
+
+        if(user_job)
         {
-            // Insert into queue the job needed to be removed. Mutex needed due to
-            // web server and simulation on different threads.
-            queue_mutex.lock();
-            cancelJobs.push(job_name);
-            queue_mutex.unlock();
+            // Insert into queue the job needed to be removed, since web server and simulation
+            // are on different threads.
+            if (not cancelJobs.push(job_name)) {
+                // Simulation thread is too far behind, put the job back so that it can be cancelled later
+                job_list_mutex.lock();
+                job_list.insert(job_name);
+                job_list_mutex.unlock();
+                return false;
+            }
+            wakeUp();
             return true;
         }
-        cerr << "RETURNING FROM cancelJob\n";
+        SERVER_LOG(Request, Debug, "Cannot cancel unknown or finished job %s", job_name.c_str());
         return false;
     }
 
     /**
-     * @brief Retrieve the list of events for the specified time period.
+     * @brief Appends the completion or failure of a job to the event log if it is a user job that was
+     * not cancelled, and wakes up the web server threads waiting for events. Only called by the
+     * simulation thread, which owns the job.
+     *
+     * @param job Job that completed or failed.
+     * @param type Whether the job completed or failed.
+     */
+    void WorkflowManager::recordJobEvent(const std::shared_ptr<wrench::StandardJob> &job, JobEvent::Type type)
+    {
+        // Check if jobs are ones submitted by user otherwise do not return anything to user.
+        auto it = user_job_names.find(job->getName());
+        if (it == user_job_names.end()) return;
+        JobEvent job_event;
+        job_event.time = this->simulation->getCurrentSimulatedDate();
+        job_event.type = type;
+        job_event.job_name = it->second;
+        job_event.submit_date = job->getSubmitDate();
+        job_event.start_date = (*(job->getTasks().begin()))->getStartDate();
+        job_event.end_date = (*(job->getTasks().begin()))->getEndDate();
+        if (job_event.end_date < 0) {
+            job_event.end_date =  (*(job->getTasks().begin()))->getFailureDate();
+        }
+        user_jobs.erase(it->second);
+        user_job_names.erase(it);
+
+        // Cancelled jobs are no longer in the job list, and their events are not reported
+        job_list_mutex.lock();
+        bool cancelled = job_list.erase(job_event.job_name) == 0;
+        job_list_mutex.unlock();
+        if (cancelled) return;
+
+        event_log_mutex.lock();
+        job_event.sequence = last_event_sequence + 1;
+        event_log.push_back(std::move(job_event));
+        last_event_sequence++;
+        if (event_log.size() > event_log_retention) {
+            event_log.pop_front();
+        }
+        event_log_mutex.unlock();
+
+        events_mutex.lock();
+        events_mutex.unlock();
+        events_condition.notify_all();
+    }
+
+    /**
+     * @brief Retrieve the list of events that occurred since the last call that did not pass a cursor.
      * 
      * @param statuses Queue to hold all statuses.
-     * @param time Expected server time in seconds.
+     * @return unsigned long Sequence number of the latest event returned (or already returned).
      */
-    void WorkflowManager::getEventStatuses(std::queue<std::string>& statuses, const time_t& time)
+    unsigned long WorkflowManager::getEventStatuses(std::queue<JobEvent>& statuses)
     {
-        // Keeps retrieving events while there are events and converts them to a string(temp) to return
-        // to client.
-        while(!events.empty())
-        {
-            // Locks the mutex because event statuses are in a queue shared by web server thread and simulation thread.
-            queue_mutex.lock();
-            auto event = events.front();
-            std::shared_ptr<wrench::StandardJob> job;
-
-            // Casts jobs to JobFailed or JobComplete and extracts the job pointer containing information.
-            // Cleans up by pushing done/failed jobs onto a queue for main thread to clean up.
-            if(auto failed = std::dynamic_pointer_cast<wrench::StandardJobFailedEvent>(event.second))
-            {
-                doneJobs.push(failed->standard_job);
-                job = failed->standard_job;
-            }
-            else if(auto complete = std::dynamic_pointer_cast<wrench::StandardJobCompletedEvent>(event.second))
-            {
-                doneJobs.push(complete->standard_job);
-                job = complete->standard_job;
+        std::lock_guard<std::mutex> lock(event_log_mutex);
+        unsigned long after = cursor_without_client;
+        for (const auto &entry : event_log) {
+            if (entry.sequence > after) {
+                statuses.push(entry);
             }
+        }
+        cursor_without_client = last_event_sequence.load();
+        return cursor_without_client;
+    }
 
-            // Check if jobs are ones submitted by user otherwise do not return anything to user.
-            if(job_list[job->getName()])
-            {
-                double submit_date = job->getSubmitDate();
-                double start_date = (*(job->getTasks().begin()))->getStartDate();
-                double end_date = (*(job->getTasks().begin()))->getEndDate();
-                if (end_date < 0) {
-                    end_date =  (*(job->getTasks().begin()))->getFailureDate();
-                }
-                statuses.push(std::to_string(event.first) + " " + event.second->toString() + " " +
-                              std::to_string(submit_date) + "|" +
-                              std::to_string(start_date) + "|" +
-                              std::to_string(end_date));
-                job_list.erase(job->getName());
+    /**
+     * @brief Retrieve the list of events that occurred after some cursor, without consuming them, so
+     * that clients can read the same events again (e.g., after a failed request or a reconnection).
+     *
+     * @param statuses Queue to hold all statuses.
+     * @param after Sequence number of the latest event the client already has (0 for all events).
+     * @param truncated Set to true if some events after the cursor are no longer retained, or if the
+     * cursor does not come from this simulation, in which case all retained events are returned.
+     * @return unsigned long Sequence number of the latest event, to be passed as the next cursor.
+     */
+    unsigned long WorkflowManager::getEventStatuses(std::queue<JobEvent>& statuses, unsigned long after,
+                                                    bool& truncated)
+    {
+        std::lock_guard<std::mutex> lock(event_log_mutex);
+        unsigned long first_retained = event_log.empty() ? last_event_sequence + 1 : event_log.front().sequence;
+        truncated = false;
+        if (after > last_event_sequence) {
+            truncated = true;
+            after = 0;
+        } else if (after + 1 < first_retained) {
+            truncated = true;
+        }
+        for (const auto &entry : event_log) {
+            if (entry.sequence > after) {
+                statuses.push(entry);
             }
-            events.pop();
-
-            queue_mutex.unlock();
         }
-        server_time = (double)time;
+        return last_event_sequence;
     }
 
     /**
-     * @brief Retrieves statuses of all simulated jobs in the simulation.
-     * 
-     * @return std::vector<std::string> List of job statuses with relevant information.
+     * @brief Sets the server time the simulation should catch up with.
+     *
+     * @param time Expected server time in seconds.
+     * @return unsigned long Sequence number of the server time update, to be passed to waitForAdvance().
+     */
+    unsigned long WorkflowManager::setServerTime(const double& time)
+    {
+        // Update the server time (which never goes backward, even if concurrent requests
+        // race) and wake up the simulation thread so that it catches up.
+        double new_server_time = time;
+        double current_server_time = server_time;
+        while (new_server_time > current_server_time and
+               not server_time.compare_exchange_weak(current_server_time, new_server_time)) {}
+        unsigned long sequence = ++requested_sequence;
+        wakeUp();
+
+        return sequence;
+    }
+
+    /**
+     * @brief Records that the batch queue has (possibly) changed, so that a new snapshot is published
+     * once the simulation has caught up. Only called by the simulation thread.
+     */
+    void WorkflowManager::markQueueChanged()
+    {
+        queue_changed = true;
+    }
+
+    /**
+     * @brief Publishes a new snapshot of the batch queue for the web server threads, with the next
+     * version. Only called by the simulation thread, which owns the batch service state: web server
+     * threads never read it directly.
      */
-    std::vector<std::string> WorkflowManager::getQueue()
+    void WorkflowManager::publishQueueSnapshot()
     {
-        std::vector<std::tuple<std::string,std::string,int,int,int,double,double>> i_queue;
-        std::vector<std::string> queue;
+        auto snapshot = std::make_shared<QueueSnapshot>();
+        snapshot->version = ++queue_version;
         auto batch_services = this->getAvailableComputeServices<BatchComputeService>();
 
         // Loops through all available batch services (should only be one supposedly in this case).
-        // and inserts into intermediary queue to extract the relevant information.
+        // and extracts the relevant information.
         for(auto const bs : batch_services)
         {
-            auto bs_queue = bs->getQueue();
-            i_queue.insert(i_queue.end(), bs_queue.begin(), bs_queue.end());
+            for (auto const &q : bs->getQueue()) {
+                QueueEntry entry;
+                entry.user = std::get<0>(q);
+                entry.job_name = std::get<1>(q);
+                auto user_job_name = user_job_names.find(entry.job_name);
+                if (user_job_name != user_job_names.end()) {
+                    entry.job_name = user_job_name->second;
+                }
+                entry.num_nodes = std::get<2>(q);
+                entry.requested_duration = std::get<4>(q);
+                entry.start_date = std::get<6>(q);
+                snapshot->jobs.push_back(std::move(entry));
+            }
         }
 
-        // Loops through intermediary queue and extracts the needed information to convert into a string
-        // before finally inserting into queue which needs to be returned. Front-end will handle parsing
-        // of informationi so information is passed as a comma-separated string.
-        for(auto const q : i_queue) {
-//            std::cerr << wrench::Simulation::getCurrentSimulatedDate() << "\n";
-//            std::cerr << std::get<0>(q) + ',' + std::get<1>(q) + ',' + std::to_string(std::get<2>(q)) +
-//                                         ',' + std::to_string(std::get<3>(q)) + ',' +
-//                                         ',' + std::to_string(std::get<4>(q)) + ',' +
-//                                         ',' + std::to_string(std::get<5>(q)) + ','
-//                                          + std::to_string(std::get<6>(q)) << "\n";
-            queue.push_back(std::get<0>(q) + ',' +
-                            std::get<1>(q) + ',' +
-                            std::to_string(std::get<2>(q)) + ',' +
-                            std::to_string(std::get<4>(q)) + ',' +
-                            std::to_string(std::get<6>(q)));
+        std::atomic_store(&published_queue, std::shared_ptr<const QueueSnapshot>(std::move(snapshot)));
+    }
+
+    /**
+     * @brief Retrieves the latest batch queue published by the simulation thread, i.e., the jobs running
+     * or waiting. This is lock-free, except for the first read of each snapshot, which keeps it for
+     * findQueueSnapshot().
+     *
+     * @return std::shared_ptr<const QueueSnapshot> Snapshot of the queue.
+     */
+    std::shared_ptr<const QueueSnapshot> WorkflowManager::getQueueSnapshot()
+    {
+        auto snapshot = std::atomic_load(&published_queue);
+
+        // Only take the lock the first time a snapshot is read
+        if (snapshot->version > last_recorded_version) {
+            std::lock_guard<std::mutex> lock(queue_snapshots_mutex);
+            if (snapshot->version > last_recorded_version) {
+                queue_snapshots.push_back(snapshot);
+                if (queue_snapshots.size() > queue_snapshot_retention) {
+                    queue_snapshots.pop_front();
+                }
+                last_recorded_version = snapshot->version;
+            }
+        }
+        return snapshot;
+    }
+
+    /**
+     * @brief Retrieves a recent snapshot of the batch queue, e.g., to compute what changed since.
+     *
+     * @param version Queue version of the snapshot.
+     * @return std::shared_ptr<const QueueSnapshot> Snapshot, or nullptr if no longer (or never) retained.
+     */
+    std::shared_ptr<const QueueSnapshot> WorkflowManager::findQueueSnapshot(unsigned long version)
+    {
+        std::lock_guard<std::mutex> lock(queue_snapshots_mutex);
+        for (auto const &snapshot : queue_snapshots) {
+            if (snapshot->version == version) {
+                return snapshot;
+            }
         }
-        return queue;
+        return nullptr;
     }
 }
 
@@ -3,17 +3,81 @@
 
 #include <wrench-dev.h>
 #include <map>
+#include <memory>
 #include <vector>
+#include <deque>
 #include <queue>
+#include <set>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#include "ring_buffer.h"
 
 namespace wrench {
 
+    /**
+     * @brief Completion or failure of a user job, as returned to clients.
+     */
+    struct JobEvent {
+        enum Type : unsigned char {
+            COMPLETED = 0,
+            FAILED = 1
+        };
+
+        /**
+         * @brief Position of the event in the event log, starting at 1.
+         */
+        unsigned long sequence;
+        /**
+         * @brief Simulated time of the event in seconds.
+         */
+        double time;
+        Type type;
+        std::string job_name;
+        /**
+         * @brief Simulated submit, start and end (or failure) dates of the job in seconds.
+         */
+        double submit_date;
+        double start_date;
+        double end_date;
+    };
+
+    /**
+     * @brief Job running or waiting in the batch queue.
+     */
+    struct QueueEntry {
+        std::string user;
+        std::string job_name;
+        int num_nodes;
+        /**
+         * @brief Requested duration in seconds.
+         */
+        int requested_duration;
+        /**
+         * @brief Simulated start date in seconds, or a negative value if the job is pending.
+         */
+        double start_date;
+
+        bool operator==(const QueueEntry &other) const {
+            return user == other.user and job_name == other.job_name and num_nodes == other.num_nodes and
+                   requested_duration == other.requested_duration and start_date == other.start_date;
+        }
+    };
+
+    /**
+     * @brief Immutable copy of the batch queue at some queue version.
+     */
+    struct QueueSnapshot {
+        unsigned long version;
+        std::vector<QueueEntry> jobs;
+    };
+
     class WorkflowManager : public WMS {
 
     public:
 
-        double simulationTime = 0.0;
+        std::atomic<double> simulationTime{0.0};
 
         // Constructor
         WorkflowManager(
@@ -22,19 +86,46 @@ namespace wrench {
             const std::string &hostname,
             const int node_count,
             const int core_count,
-            std::vector<std::tuple<int,int>> background_jobs
+            std::vector<std::tuple<int,int>> background_jobs,
+            const bool event_driven_advance = true
         );
 
         std::string addJob(const double& requested_duration,
                      const unsigned int& num_nodes, const double& actual_duration);
+
+        std::vector<std::string> addJobs(const std::vector<std::tuple<double, unsigned int, double>>& job_specs);
         
         bool cancelJob(const std::string& job_name);
         
-        void getEventStatuses(std::queue<std::string>& statuses, const time_t& time);
+        unsigned long getEventStatuses(std::queue<JobEvent>& statuses);
+
+        unsigned long getEventStatuses(std::queue<JobEvent>& statuses, unsigned long after, bool& truncated);
+
+        unsigned long setServerTime(const double& time);
+
+        bool waitForAdvance(unsigned long sequence, double timeout);
+
+        bool waitUntilStarted(double timeout);
+
+        bool waitForEvents(double timeout);
+
+        bool waitForEvents(unsigned long after, double timeout);
+
+        bool isStopping() const;
+
+        unsigned long advanceToNextJobEvent(double max_time);
+
+        bool hasPendingJobs();
 
         void stopServer();
 
-        std::vector<std::string> getQueue();
+        std::shared_ptr<const QueueSnapshot> getQueueSnapshot();
+
+        std::shared_ptr<const QueueSnapshot> findQueueSnapshot(unsigned long version);
+
+        unsigned long getNumWakeups() const;
+
+        std::map<std::string, std::tuple<size_t, size_t, unsigned long>> getQueueDepths() const;
 
     private:
         int main() override;
@@ -52,45 +143,197 @@ namespace wrench {
         /**
          * @brief Flag value to determine if the simulation needs to end.
          */
-        bool stop = false;
+        std::atomic<bool> stop{false};
+
+        /**
+         * @brief Job requested by the user, which the simulation thread creates and submits (WRENCH
+         * objects are only ever used by the simulation thread).
+         */
+        struct JobSpec {
+            /**
+             * @brief Name returned to the user, assigned before the job is created.
+             */
+            std::string job_name;
+            double requested_duration;
+            unsigned int num_nodes;
+            double actual_duration;
+        };
 
         /**
-         * @brief Holds queue of events within the simulation to allow it to pass between web server and simulation threads.
+         * @brief Holds queue of names of jobs to cancel within the simulation to allow it to pass between web server and simulation threads.
          */
-        std::queue<std::pair<double, std::shared_ptr<wrench::WorkflowExecutionEvent>>> events;
+        RingBuffer<std::string> cancelJobs{1024};
 
         /**
-         * @brief Holds queue of jobs to cancel within the simulation to allow it to pass between web server and simulation threads.
+         * @brief Holds queue of batches of jobs to start within the simulation to allow it to pass between web server and simulation threads.
          */
-        std::queue<std::string> cancelJobs;
+        RingBuffer<std::vector<JobSpec>> toSubmitJobs{1024};
 
         /**
-         * @brief Holds queue of completed jobs within the simulation in order to clean up
-         * to allow it to pass between web server and simulation threads.
+         * @brief Names of the jobs added by the user that have not completed, failed, or been cancelled yet.
          */
-        std::queue<std::shared_ptr<wrench::WorkflowJob>> doneJobs;
+        std::set<std::string> job_list;
 
         /**
-         * @brief Holds queue of jobs to start within the simulation to allow it to pass between web server and simulation threads.
+         * @brief Protects job_list. Only held briefly, including by the simulation thread.
          */
-        std::queue<std::pair<std::shared_ptr<wrench::StandardJob>, std::map<std::string, std::string>>> toSubmitJobs;
+        std::mutex job_list_mutex;
 
         /**
-         * @brief Holds map of jobs started by the user.
+         * @brief Number of jobs added by the user so far, used to name them. Protected by job_list_mutex.
          */
-        std::map<std::string, std::shared_ptr<wrench::WorkflowJob>> job_list;
+        unsigned long num_created_jobs = 0;
+
+        /**
+         * @brief Jobs submitted on behalf of the user that have not completed, failed, or been cancelled
+         * yet, keyed by the name returned to the user, and that name keyed by the job's WRENCH name.
+         * Only used by the simulation thread.
+         */
+        std::map<std::string, std::shared_ptr<wrench::StandardJob>> user_jobs;
+        std::map<std::string, std::string> user_job_names;
+
+        /**
+         * @brief Number of jobs submitted on behalf of the user so far, used to name their tasks. Only
+         * used by the simulation thread.
+         */
+        unsigned long num_submitted_jobs = 0;
 
         /**
          * @brief Server time in seconds due to how wrench uses number of seconds since simulation started.
          */
-        double server_time = 0;
+        std::atomic<double> server_time{0};
 
+        /**
+         * @brief Mutex only used to put the simulation thread to sleep and to wait for it to catch up.
+         */
         std::mutex queue_mutex;
+
+        /**
+         * @brief Signaled by the web server thread whenever there is work for the simulation thread.
+         */
+        std::condition_variable wakeup_condition;
+
+        /**
+         * @brief Whether the simulation thread is (about to be) asleep, in which case it must be notified.
+         */
+        std::atomic<bool> sleeping{false};
+
+        /**
+         * @brief Number of times the main loop woke up to do work (used to measure idle overhead).
+         */
+        std::atomic<unsigned long> num_wakeups{0};
+
+        /**
+         * @brief Signaled by the simulation thread whenever it has caught up with the server time.
+         */
+        std::condition_variable advance_condition;
+
+        /**
+         * @brief Sequence number of the latest server time update requested by the web server thread.
+         */
+        std::atomic<unsigned long> requested_sequence{0};
+
+        /**
+         * @brief Sequence number of the latest server time update the simulation has caught up with.
+         */
+        std::atomic<unsigned long> completed_sequence{0};
+
+        /**
+         * @brief Used by web server threads to wait for events to be logged (long polling).
+         */
+        std::mutex events_mutex;
+        std::condition_variable events_condition;
+
+        /**
+         * @brief Sequence-numbered log of the user job events, appended to by the simulation thread, so
+         * that several clients can read them (and read them again) from their own cursor.
+         */
+        std::deque<JobEvent> event_log;
+
+        /**
+         * @brief Protects event_log, and updates of last_event_sequence and cursor_without_client.
+         */
+        std::mutex event_log_mutex;
+
+        /**
+         * @brief Sequence number of the latest entry appended to event_log (entries start at 1).
+         */
+        std::atomic<unsigned long> last_event_sequence{0};
+
+        /**
+         * @brief Cursor shared by the requests that do not pass one, so that they keep seeing each
+         * event once.
+         */
+        std::atomic<unsigned long> cursor_without_client{0};
+
+        /**
+         * @brief Maximum number of entries kept in event_log.
+         */
+        static const size_t event_log_retention = 4096;
+
+        /**
+         * @brief Whether the main loop has started, i.e., jobs can be added.
+         */
+        std::atomic<bool> started{false};
+
+        /**
+         * @brief Simulated time up to which the simulation should stop at the first user job event, or
+         * a negative value if no such request is in progress.
+         */
+        std::atomic<double> next_event_deadline{-1.0};
+
+        /**
+         * @brief Latest batch queue snapshot, replaced (never modified) by the simulation thread and
+         * read by web server threads, only through std::atomic_load()/std::atomic_store().
+         */
+        std::shared_ptr<const QueueSnapshot> published_queue;
+
+        /**
+         * @brief Version of the latest published snapshot. Only used by the simulation thread.
+         */
+        unsigned long queue_version = 0;
+
+        /**
+         * @brief Whether the queue has changed since the last published snapshot (initially true, so
+         * that the background jobs get published). Only used by the simulation thread.
+         */
+        bool queue_changed = true;
+
+        /**
+         * @brief Latest snapshots of the queue read by clients, oldest first, so that clients can ask
+         * what changed since the version they have. Only used by web server threads.
+         */
+        std::deque<std::shared_ptr<const QueueSnapshot>> queue_snapshots;
+        std::mutex queue_snapshots_mutex;
+        std::atomic<unsigned long> last_recorded_version{0};
+
+        /**
+         * @brief Maximum number of snapshots kept in queue_snapshots.
+         */
+        static const size_t queue_snapshot_retention = 64;
+
+        bool hasWork() const;
+
+        void markQueueChanged();
+
+        void publishQueueSnapshot();
+
+        void wakeUp();
+
+        void recordJobEvent(const std::shared_ptr<wrench::StandardJob> &job, JobEvent::Type type);
+
+        std::vector<std::string> queueJobs(const std::vector<std::tuple<double, unsigned int, double>>& job_specs);
+
         int node_count;
         int core_count;
 
         std::vector<std::tuple<int,int>> background_jobs;
 
+        /**
+         * @brief Whether time advances straight to the next event (true) or in 1-second ticks (false).
+         */
+        bool event_driven_advance;
+
     };
 }
 